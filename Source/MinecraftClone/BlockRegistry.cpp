@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BlockRegistry.h"
+#include "Chunk.h"
+
+uint8 FBlockRegistry::Flags[MaxBlockTypes];
+uint8 FBlockRegistry::Emission[MaxBlockTypes];
+uint8 FBlockRegistry::Tiles[MaxBlockTypes][6];
+bool FBlockRegistry::bHasEmitters = false;
+
+static FBlockDefinition MakeBlock(BlockType blockType, int32 top, int32 side, int32 bottom, bool bOpaque = true)
+{
+	FBlockDefinition definition;
+	definition.Id = int32(blockType);
+	definition.TopTile = top; definition.SideTile = side; definition.BottomTile = bottom;
+	definition.bOpaque = bOpaque;
+	return definition;
+}
+
+// The blocks of the BlockType enum, leaves show the faces behind them and dim the light
+static const FBlockDefinition BUILT_IN_BLOCKS[] =
+{
+	MakeBlock(BlockType::GRASS, 0, 3, 2),
+	MakeBlock(BlockType::DIRT, 2, 2, 2),
+	MakeBlock(BlockType::STONE, 1, 1, 1),
+	MakeBlock(BlockType::WOOD, 5, 4, 5),
+	MakeBlock(BlockType::LEAVES, 6, 6, 6, false)
+};
+
+// So the tables are filled before anything reads them, without waiting for a BeginPlay
+static struct FBuiltInBlockRegistry
+{
+	FBuiltInBlockRegistry() { FBlockRegistry::Initialize(); }
+} GBuiltInBlockRegistry;
+
+void FBlockRegistry::Initialize(const UDataTable* table)
+{
+	FMemory::Memzero(Flags, sizeof(Flags));
+	FMemory::Memzero(Emission, sizeof(Emission));
+	FMemory::Memzero(Tiles, sizeof(Tiles));
+	bHasEmitters = false;
+
+	Flags[uint8(BlockType::AIR)] = FLAG_REGISTERED | FLAG_TRANSPARENT;
+
+	for (const FBlockDefinition& definition : BUILT_IN_BLOCKS)
+		Register(uint8(definition.Id), definition);
+
+	if (!table) return;
+
+	if (table->GetRowStruct() != FBlockDefinition::StaticStruct())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Block table %s doesn't use FBlockDefinition rows, keeping the built in blocks"), *table->GetName());
+		return;
+	}
+
+	table->ForeachRow<FBlockDefinition>(TEXT("FBlockRegistry::Initialize"), [](const FName& name, const FBlockDefinition& definition)
+	{
+		if (definition.Id <= 0 || definition.Id >= MaxBlockTypes)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Block %s has id %d, it has to be between 1 and %d"), *name.ToString(), definition.Id, MaxBlockTypes - 1);
+			return;
+		}
+
+		Register(uint8(definition.Id), definition);
+	});
+}
+
+void FBlockRegistry::Register(uint8 id, const FBlockDefinition& definition)
+{
+	// The mesher and the collision take opaque blocks as solid and light can't cross them, so neither can be transparent
+	uint8 flags = FLAG_REGISTERED;
+	if (definition.bOpaque) flags |= FLAG_OPAQUE | FLAG_SOLID;
+	else
+	{
+		if (definition.bTransparent) flags |= FLAG_TRANSPARENT;
+		if (definition.bSolid) flags |= FLAG_SOLID;
+	}
+	Flags[id] = flags;
+
+	Emission[id] = uint8(FMath::Clamp(definition.LightEmission, 0, int32(FChunkLightStorage::MaxLight)));
+	bHasEmitters |= Emission[id] > 0;
+
+	uint8 top = uint8(FMath::Clamp(definition.TopTile, 0, 255));
+	uint8 side = uint8(FMath::Clamp(definition.SideTile, 0, 255));
+	uint8 bottom = uint8(FMath::Clamp(definition.BottomTile, 0, 255));
+	for (int32 d = 0; d < MeshData::Direction::SIZE; d++)
+		Tiles[id][d] = d == MeshData::UP ? top : d == MeshData::DOWN ? bottom : side;
+}
@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataTable.h"
+#include "BlockRegistry.generated.h"
+
+enum class BlockType : uint8;
+
+// A row of the block table given to FBlockRegistry::Initialize, the row name is only for the editor
+USTRUCT(BlueprintType)
+struct MINECRAFTCLONE_API FBlockDefinition : public FTableRowBase
+{
+	GENERATED_BODY()
+
+	// The BlockType value stored in the chunks, 0 is always AIR
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Block", meta = (ClampMin = "1", ClampMax = "255"))
+	int32 Id = 1;
+
+	// Atlas tiles, see MeshData::ATLAS_SIZE
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Block", meta = (ClampMin = "0", ClampMax = "255"))
+	int32 TopTile = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Block", meta = (ClampMin = "0", ClampMax = "255"))
+	int32 SideTile = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Block", meta = (ClampMin = "0", ClampMax = "255"))
+	int32 BottomTile = 0;
+
+	// Hides the faces of the blocks next to it and stops light, opaque blocks are always solid
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Block")
+	bool bOpaque = true;
+
+	// Not opaque blocks let light through, transparent ones without dimming it more than air does
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Block")
+	bool bTransparent = false;
+
+	// Collides and can be stood on
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Block")
+	bool bSolid = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Block", meta = (ClampMin = "0", ClampMax = "15"))
+	int32 LightEmission = 0;
+};
+
+// What every block type looks like and how it behaves, as tables indexed by the BlockType byte so the
+// mesher, the culling and the lighting pay one load per lookup however many types there are.
+// The built in blocks are there from startup, Initialize can replace them with a data table before any
+// chunk is generated, after that the tables are only read, from any thread.
+class MINECRAFTCLONE_API FBlockRegistry
+{
+public:
+	static const int32 MaxBlockTypes = 256;
+
+	// Back to the built in blocks, then the rows of table on top if there's one. Game thread, only
+	// while no chunk is being built, meshed or lit
+	static void Initialize(const UDataTable* table = nullptr);
+
+	// AIR and the ids with a definition, chunks shouldn't hold anything else
+	static FORCEINLINE bool IsRegistered(BlockType blockType) { return (Flags[uint8(blockType)] & FLAG_REGISTERED) != 0; }
+
+	// Hides the faces next to it, stops light and closes off sections for the visibility
+	static FORCEINLINE bool IsOpaque(BlockType blockType) { return (Flags[uint8(blockType)] & FLAG_OPAQUE) != 0; }
+
+	// Lets light through at the same cost as air, the blocks that are neither opaque nor transparent
+	// (leaves) take one more level
+	static FORCEINLINE bool IsTransparent(BlockType blockType) { return (Flags[uint8(blockType)] & FLAG_TRANSPARENT) != 0; }
+
+	// Collides
+	static FORCEINLINE bool IsSolid(BlockType blockType) { return (Flags[uint8(blockType)] & FLAG_SOLID) != 0; }
+
+	static FORCEINLINE uint8 GetEmission(BlockType blockType) { return Emission[uint8(blockType)]; }
+
+	// Atlas tile of a face, direction is a MeshData::Direction
+	static FORCEINLINE int32 GetTile(BlockType blockType, int32 direction) { return Tiles[uint8(blockType)][direction]; }
+
+	// False skips looking for light sources in new chunks
+	static bool HasEmitters() { return bHasEmitters; }
+
+private:
+	enum : uint8
+	{
+		FLAG_REGISTERED = 1 << 0,
+		FLAG_OPAQUE = 1 << 1,
+		FLAG_TRANSPARENT = 1 << 2,
+		FLAG_SOLID = 1 << 3
+	};
+
+	static uint8 Flags[MaxBlockTypes];
+	static uint8 Emission[MaxBlockTypes];
+	// In MeshData::Direction order
+	static uint8 Tiles[MaxBlockTypes][6];
+	static bool bHasEmitters;
+
+	static void Register(uint8 id, const FBlockDefinition& definition);
+};
@@ -2,6 +2,101 @@
 
 #include "Chunk.h"
 #include "Async/Async.h"
+#include "ChunkLoadScheduler.h"
+#include "SectionFaceMasks.h"
+#include "ChunkLod.h"
+#include "TerrainGenerator.h"
+#include "ChunkRegionStore.h"
+#include "ChunkCollisionQueue.h"
+#include "ChunkLighting.h"
+#include "ChunkGreedyMaterial.h"
+#include "ChunkStats.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeExit.h"
+#include "UObject/ConstructorHelpers.h"
+
+// Chunk offsets of the LEFT, RIGHT, FORWARD and BACK neighbors, matching MeshData::NORMALS
+static const int32 NEIGHBOR_OFFSETS[4][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+
+// Axes of every MeshData::Direction in ijk order, the normal one and the two that span the face
+static const int32 NORMAL_AXIS[MeshData::Direction::SIZE] = { 0, 0, 2, 2, 1, 1 };
+static const int32 SLICE_AXES[MeshData::Direction::SIZE][2] = { {2, 1}, {2, 1}, {1, 0}, {1, 0}, {2, 0}, {2, 0} };
+
+const TCHAR* const MeshData::DirectionImage[Direction::SIZE] =
+{
+	TEXT("UP"), TEXT("DOWN"), TEXT("LEFT"), TEXT("RIGHT"), TEXT("FORWARD"), TEXT("BACK")
+};
+
+const FVector MeshData::NORMALS[Direction::SIZE] =
+{ FVector(0,0,1), // up
+  FVector(0,0,-1), // down
+  FVector(-1,0,0), // left
+  FVector(1,0,0), // right
+  FVector(0,-1,0), // forward
+  FVector(0,1,0) // back 
+};
+
+const FProcMeshTangent MeshData::TANGENTS[Direction::SIZE] =
+{ FProcMeshTangent(1, 0, 0), // up
+  FProcMeshTangent(1, 0, 0), // down
+  FProcMeshTangent(0, 0, 1), // left
+  FProcMeshTangent(0, 0, 1), // right
+  FProcMeshTangent(0, 0, 1), // forward
+  FProcMeshTangent(0, 0, 1) // back
+};
+
+const FVector MeshData::VERTICES[Direction::SIZE][4] =
+{
+	{ FVector(1, 0, 1), FVector(0, 0, 1), FVector(1, 1, 1), FVector(0, 1, 1) },
+	{ FVector(0, 0, 0), FVector(1, 0, 0), FVector(0, 1, 0), FVector(1, 1, 0) },
+	{ FVector(0, 0, 0), FVector(0, 1, 0), FVector(0, 0, 1), FVector(0, 1, 1) },
+	{ FVector(1, 1, 0), FVector(1, 0, 0), FVector(1, 1, 1), FVector(1, 0, 1) },
+	{ FVector(0, 0, 0), FVector(0, 0, 1), FVector(1, 0, 0), FVector(1, 0, 1) },
+	{ FVector(0, 1, 0), FVector(1, 1, 0), FVector(0, 1, 1), FVector(1, 1, 1) }
+};
+
+const FVector2D MeshData::UVS[Direction::SIZE][4] =
+{
+	{ FVector2D(0.9, 0.1), FVector2D(0.1, 0.1), FVector2D(0.9, 0.9), FVector2D(0.1, 0.9) }, // up
+	{ FVector2D(0.01, 0.01), FVector2D(0.99, 0.01), FVector2D(0.01, 0.99), FVector2D(0.99, 0.99) }, // down
+	{ FVector2D(0.01, 0.01), FVector2D(0.99, 0.01), FVector2D(0.01, 0.99), FVector2D(0.99, 0.99) }, // left
+	{ FVector2D(0.99, 0.01), FVector2D(0.01, 0.01), FVector2D(0.99, 0.99), FVector2D(0.01, 0.99) }, // right
+	{ FVector2D(0.01, 0.01), FVector2D(0.01, 0.99), FVector2D(0.99, 0.01), FVector2D(0.99, 0.99) }, // forward
+	{ FVector2D(0.01, 0.01), FVector2D(0.99, 0.01), FVector2D(0.01, 0.99), FVector2D(0.99, 0.99) }  // back
+};
+
+const int32 MeshData::UV_AXES[Direction::SIZE][2] =
+{
+	{ 0, 1 }, // up
+	{ 0, 1 }, // down
+	{ 1, 2 }, // left
+	{ 1, 2 }, // right
+	{ 0, 2 }, // forward
+	{ 0, 2 }  // back
+};
+
+const FVector2D MeshData::UVS_Inverted[Direction::SIZE][4] =
+{
+	{ FVector2D(0, 1), FVector2D(1, 1), FVector2D(0, 0), FVector2D(1, 0) }, // up
+	{ FVector2D(1, 1), FVector2D(0, 1), FVector2D(1, 0), FVector2D(0, 0) }, // down
+	{ FVector2D(1, 1), FVector2D(0, 1), FVector2D(1, 0), FVector2D(0, 0) }, // left
+	{ FVector2D(0, 1), FVector2D(1, 1), FVector2D(0, 0), FVector2D(1, 0) }, // right
+	{ FVector2D(1, 1), FVector2D(1, 0), FVector2D(0, 1), FVector2D(0, 0) }, // forward
+	{ FVector2D(1, 1), FVector2D(0, 1), FVector2D(1, 0), FVector2D(0, 0) }  // back
+};
+
+// The per block CheckIfNeighboorIsAir path is kept as the reference to validate the bitmask one against
+static int32 GBitmaskMesher = 1;
+static FAutoConsoleVariableRef CVarBitmaskMesher(
+	TEXT("Chunk.BitmaskMesher"),
+	GBitmaskMesher,
+	TEXT("1 to find the visible faces of a section with row bitmasks, 0 to check every block neighbor one by one"));
+
+static int32 GCaveCulling = 1;
+static FAutoConsoleVariableRef CVarCaveCulling(
+	TEXT("Chunk.CaveCulling"),
+	GCaveCulling,
+	TEXT("1 to hide the sections the camera can't see through the sections around it, 0 to show every section"));
 
 // Creating a standard root object.
 AChunk::AChunk()
@@ -13,115 +108,150 @@ AChunk::AChunk()
 	RootComponent = mesh;
 	// New in UE 4.17, multi-threaded PhysX cooking.
 	mesh->bUseAsyncCooking = true;
+	// The sections don't create collision, FChunkCollisionQueue gives nearby chunks boxes instead
+	mesh->bUseComplexAsSimpleCollision = false;
 	// Sets default values
 
-	UMaterial* m = LoadObject<UMaterial>(NULL, TEXT("/Game/Textures/TileTextures_Mat"));
+	// Looked up once and not on every spawn
+	static ConstructorHelpers::FObjectFinder<UMaterial> FaceMaterial(TEXT("/Game/Textures/TileTextures_Mat"));
+	mFaceMaterial = FaceMaterial.Object;
 
 	for(int i = 0; i < 16; i++)
-		mesh->SetMaterial(i, m);
-
-
-	UE_LOG(LogTemp, Log, TEXT("Generated %d"), this);
+		mesh->SetMaterial(i, mFaceMaterial);
 }
 
 void AChunk::PostDuplicate(EDuplicateMode::Type DuplicateMode)
 {
 	Super::PostDuplicate(DuplicateMode);
-
-	UE_LOG(LogTemp, Log, TEXT("Duplicated to %d"), this);
 }
 
 void AChunk::BeginDestroy()
 {
 	Super::BeginDestroy();
-
-	UE_LOG(LogTemp, Log, TEXT("Destroying %d"), this);
 }
 
 // This is called when actor is spawned (at runtime or when you drop it into the world in editor)
 void AChunk::PostActorCreated()
 {
 	Super::PostActorCreated();
-
-	UE_LOG(LogTemp, Log, TEXT("PostActorCreated Blocks Size %d %d %d"), mBlocks.Num(), &mBlocks, this);
 }
 
 // This is called when actor is already in level and map is opened
 void AChunk::PostLoad()
 {
 	Super::PostLoad();
-
-	UE_LOG(LogTemp, Log, TEXT("PostLoad Chunk Mem Size %d"), sizeof(mBlocks));
 }
 
 // Each chunk it's a stack of sections, one on top of another
 // For a 16x16x256 chunk, the sectionSideWidth will be 16, and the number of Sections is 16, 16*16 = 256
-TArray<BlockType> AChunk::GenerateChunkData(int chunkI, int chunkJ, int sectionSideWidth, int numberOfSections,
-	int& sideWidth, int& sectionCount,
-	TFunction <BlockType(int32 i, int32 j, int32 k)> PopulateBlock)
+FChunkBlockStorage AChunk::GenerateChunkData(int chunkI, int chunkJ, int sectionSideWidth, int numberOfSections,
+	int& sideWidth, int& sectionCount, const IChunkGenerator& generator)
 {
+	CHUNK_STAGE_SCOPE(STAT_ChunkGenerate, Generate);
+
 	// Setup the chunk size
 	sideWidth = sectionSideWidth; sectionCount = numberOfSections;
 
-	// Setup the block array
-	TArray<BlockType> blocks;
-	blocks.SetNum(numberOfSections * sectionSideWidth * sectionSideWidth * sectionSideWidth);
+	// Sections the generator doesn't fill stay AIR
+	FChunkBlockStorage blocks(sectionSideWidth, numberOfSections, BlockType::AIR);
+	generator.GenerateChunk(chunkI, chunkJ, blocks);
 
-	int I, J, K; 
-	for (int i = 0; i < numberOfSections * sectionSideWidth * sectionSideWidth * sectionSideWidth; i++)
+	return blocks;
+}
+
+bool AChunk::HasGreedyMaterial()
+{
+	return FChunkGreedyMaterial::Get() != nullptr;
+}
+
+void AChunk::SetMeshingMode(MeshingMode meshingMode)
+{
+	// The per face material would sample the whole atlas on greedy quads
+	UMaterialInterface* greedyMaterial = meshingMode == MeshingMode::GREEDY ? FChunkGreedyMaterial::Get() : nullptr;
+	if (meshingMode == MeshingMode::GREEDY && !greedyMaterial)
 	{
-		GetIJKFromPositionInTArray(i, sectionSideWidth, I, J, K);
-		blocks[i] = PopulateBlock(I, J, K);
+		UE_LOG(LogTemp, Error, TEXT("GREEDY meshing has no greedy material, meshing %s with PER_FACE"), *GetName());
+		meshingMode = MeshingMode::PER_FACE;
 	}
 
-	return blocks;
+	mMeshingMode = meshingMode;
+
+	UMaterialInterface* m = mMeshingMode == MeshingMode::GREEDY ? greedyMaterial : mFaceMaterial;
+	for (int i = 0; i < 16; i++)
+		mesh->SetMaterial(i, m);
 }
 
-void AChunk::CreateVoxelChunk(TArray<BlockType> blocks, int sectionSide, int sectionCount)
+void AChunk::CreateVoxelChunk(const TArray<BlockType>& blocks, int sectionSide, int sectionCount)
 {
-	mBlocks = TArray<BlockType>(blocks);
+	mBlocks.SetAll(blocks, sectionSide, sectionCount);
 	mSectionSide = sectionSide; mSectionCount = sectionCount;
-
-	UE_LOG(LogTemp, Log, TEXT("Blocks Size %d %d %d"), mBlocks.Num(), &mBlocks, this);
+	FChunkLighting::Compute(mBlocks, mLight);
+	SetMeshingMode(mMeshingMode);
 
 	// Generate the mesh data by sections, each of sectionSide*sectionSide, start at the bottom
 
 	for (int32 section = 0; section < mSectionCount; section++)
 	{
 		// Get mesh data for this section only
-		MeshData* d = GetMeshData(0,0, section, mSectionCount, mBlocks, mSectionSide);
+		MeshData* d = GetMeshData(0,0, section, FChunkVolumeView(mBlocks, nullptr, &mLight), mMeshingMode);
 
 		// Create the section
-		mesh->CreateMeshSection_LinearColor(section, d->vertices, d->Triangles, d->normals, d->UV0, d->vertexColors, d->tangents, true);
+		UploadSection(section, d);
 
-		delete(d); d = NULL;
+		FMeshDataPool::Release(d); d = NULL;
 	}
 
-	// Enable collision data
-	mesh->ContainsPhysicsTriMeshData(true);
+	// Not in the ChunkRegistry, so FChunkCollisionQueue never sees it
+	mHasCollision = true;
+	SetCollisionBoxes(FChunkCollisionQueue::GetCollisionBoxes(mBlocks));
 }
 
 // Gets the mesh information for a given section of the chunk
 // Note that any TArrays passed in will be overwritten
 TArray<MeshData*> AChunk::GetMeshDataForChunk(int32 chunkI, int32 chunkJ, 
-	int32 sectionCount, TArray<BlockType> blocks, int32 sectionSide)
+	const FChunkVolumeView& volume, MeshingMode meshingMode, int32 lod)
 {
-	TArray<MeshData*> chunkMeshData; chunkMeshData.SetNum(sectionCount);
+	TArray<MeshData*> chunkMeshData; chunkMeshData.SetNum(volume.GetSectionCount());
 
 	// Get mesh data for all sections
-	for (int32 section = 0; section < sectionCount; section++)
+	for (int32 section = 0; section < volume.GetSectionCount(); section++)
 	{
-		chunkMeshData[section] = GetMeshData(chunkI, chunkJ, section, sectionCount, blocks, sectionSide);
+		chunkMeshData[section] = lod > 0 ? GetLodMeshData(chunkI, chunkJ, section, volume, meshingMode, lod) :
+			GetMeshData(chunkI, chunkJ, section, volume, meshingMode);
 	}
 
 	return chunkMeshData;
 }
 
+MeshData* AChunk::GetLodMeshData(int32 chunkI, int32 chunkJ, int32 sectionID, const FChunkVolumeView& volume,
+	MeshingMode meshingMode, int32 lod)
+{
+	MeshData* result = GetMeshData(chunkI, chunkJ, sectionID, volume, meshingMode);
+	if (lod == 0) return result;
+
+	double startTime = FPlatformTime::Seconds();
+	result->lodScale = 1 << lod;
+	AddSkirts(volume, sectionID, result);
+	result->meshingSeconds += FPlatformTime::Seconds() - startTime;
+
+	return result;
+}
+
 // Gets the mesh information for a given section of the chunk
 // Note that any TArrays passed in will be overwritten
-MeshData* AChunk::GetMeshData(int32 chunkI, int32 chunkJ, int32 sectionID, int32 sectionCount, TArray<BlockType> blocks, int32 sectionSide)
+MeshData* AChunk::GetMeshData(int32 chunkI, int32 chunkJ, int32 sectionID, const FChunkVolumeView& volume,
+	MeshingMode meshingMode)
 {
-	MeshData* result = new MeshData();
+	CHUNK_STAGE_SCOPE(STAT_ChunkMesh, Mesh);
+
+	double startTime = FPlatformTime::Seconds();
+	MeshData* result = FMeshDataPool::Acquire();
+	int32 sectionCount = volume.GetSectionCount(), sectionSide = volume.GetSectionSide();
+	const FChunkBorders* borders = volume.GetBorders();
+
+	// Recycled MeshData rarely need more room than they had, when they do it shows in "stat Chunks"
+	int32 startCapacity = result->quads.Max();
+	ON_SCOPE_EXIT { if (result->quads.Max() > startCapacity) FMeshDataPool::CountGrowth(); };
 
 	if (sectionID >= sectionCount)
 	{
@@ -129,13 +259,38 @@ MeshData* AChunk::GetMeshData(int32 chunkI, int32 chunkJ, int32 sectionID, int32
 		return result;
 	}
 
-	// Clear the arrays
-	result->vertices.Empty(); result->Triangles.Empty(); result->normals.Empty();
-	result->UV0.Empty(); result->tangents.Empty(); result->vertexColors.Empty();
-
+	result->sectionID = sectionID;
 	result->sectionCount = sectionCount; result->sectionSide = sectionSide;
-	result->blocks = blocks;
 	result->chunkI = chunkI; result->chunkJ = chunkJ;
+	result->meshingMode = meshingMode;
+	result->neighborsLoaded = borders ? borders->loadedMask : 0;
+	result->connectivity = FSectionConnectivity::Compute(volume.GetBlocks(), sectionID);
+
+	// Skip the sections that can't have any face without going through their blocks
+	if (IsSectionHidden(volume, sectionID))
+	{
+		result->meshingSeconds = FPlatformTime::Seconds() - startTime;
+		return result;
+	}
+
+	FSectionFaceMasks masks;
+	if (GBitmaskMesher) masks.Build(volume, sectionID);
+
+	if (meshingMode == MeshingMode::GREEDY)
+	{
+		AddGreedyFaces(volume, sectionID, result, GBitmaskMesher ? &masks : nullptr);
+
+		result->meshingSeconds = FPlatformTime::Seconds() - startTime;
+		return result;
+	}
+
+	if (GBitmaskMesher)
+	{
+		AddVisibleFaces(volume, masks, sectionID, result);
+
+		result->meshingSeconds = FPlatformTime::Seconds() - startTime;
+		return result;
+	}
 
 	int initialI = sectionID * sectionSide, lastI = (sectionID + 1) * sectionSide;
 
@@ -145,39 +300,195 @@ MeshData* AChunk::GetMeshData(int32 chunkI, int32 chunkJ, int32 sectionID, int32
 		{
 			for (int k = 0; k < sectionSide; k++)
 			{
-				if (blocks[GetPositionInTArray(i,j,k,sectionSide)] == BlockType::AIR) continue;
+				if (volume.Get(i, j, k) == BlockType::AIR) continue;
 				for (int d = 0; d < MeshData::Direction::SIZE; d++)
 				{
-					if (CheckIfNeighboorIsAir(MeshData::Direction(d), blocks, i, j, k, sectionCount, sectionSide, *result))
+					if (CheckIfNeighboorIsAir(MeshData::Direction(d), volume, i, j, k, *result))
 					{
-						AddVoxelFace(MeshData::Direction(d), blocks[GetPositionInTArray(i, j, k, sectionSide)],
-							result, i, j, k);
+						AddVoxelFace(MeshData::Direction(d), volume.Get(i, j, k),
+							result, i, j, k, GetCornerLights(volume, MeshData::Direction(d), i, j, k, *result));
 					}
 				}
 			}
 		}
 	}
 
+	result->meshingSeconds = FPlatformTime::Seconds() - startTime;
 	return result;
 }
 
-bool AChunk::CheckIfNeighboorIsAir(MeshData::Direction direction, TArray<BlockType>& blocks, int i, int j, int k,
-	int sectionCount, int sectionSide, MeshData& data)
+// Same faces and order as the per block loop, only going through the set bits of every row
+void AChunk::AddVisibleFaces(const FChunkVolumeView& volume, const FSectionFaceMasks& masks, int32 sectionID, MeshData* data)
+{
+	data->quads.Reserve(masks.CountFaces());
+
+	int32 sectionSide = volume.GetSectionSide();
+	const TArray<BlockType>& sectionBlocks = masks.GetBlocks();
+	int initialI = sectionID * sectionSide;
+
+	for (int32 localI = 0; localI < sectionSide; localI++)
+	{
+		for (int32 j = 0; j < sectionSide; j++)
+		{
+			uint32 row = masks.GetAnyRow(localI, j);
+			while (row)
+			{
+				int32 k = FMath::CountTrailingZeros(row);
+				row &= row - 1;
+
+				BlockType blockType = sectionBlocks[(localI * sectionSide + j) * sectionSide + k];
+				for (int d = 0; d < MeshData::Direction::SIZE; d++)
+				{
+					if (!masks.IsVisible(d, localI, j, k)) continue;
+
+					AddVoxelFace(MeshData::Direction(d), blockType, data, initialI + localI, j, k,
+						GetCornerLights(volume, MeshData::Direction(d), initialI + localI, j, k, *data));
+				}
+			}
+		}
+	}
+}
+
+// Greedy meshing, for every direction go slice by slice through the section building a mask of
+// the visible faces, then grow each face into the widest and tallest rectangle of matching faces
+void AChunk::AddGreedyFaces(const FChunkVolumeView& volume, int32 sectionID,
+	MeshData* data, const FSectionFaceMasks* masks)
+{
+	int32 sectionSide = volume.GetSectionSide();
+
+	// 0 means no face, otherwise (blockType << 16 | textureIndex) + 1 so only the same block and tile merge,
+	// with the corner lights in the high 32 bits so only faces lit the same way merge too
+	TArray<uint64> mask; mask.SetNumUninitialized(sectionSide * sectionSide);
+	TArray<BlockType> maskBlocks; maskBlocks.SetNumUninitialized(sectionSide * sectionSide);
+
+	for (int d = 0; d < MeshData::Direction::SIZE; d++)
+	{
+		MeshData::Direction direction = MeshData::Direction(d);
+		int32 normalAxis = NORMAL_AXIS[d], uAxis = SLICE_AXES[d][0], vAxis = SLICE_AXES[d][1];
+
+		for (int32 slice = 0; slice < sectionSide; slice++)
+		{
+			int32 local[3];
+			local[normalAxis] = slice;
+
+			for (int32 v = 0; v < sectionSide; v++)
+			{
+				for (int32 u = 0; u < sectionSide; u++)
+				{
+					local[uAxis] = u; local[vAxis] = v;
+					int i = sectionID * sectionSide + local[0], j = local[1], k = local[2];
+
+					bool visible;
+					BlockType blockType;
+					if (masks)
+					{
+						visible = masks->IsVisible(d, local[0], j, k);
+						blockType = masks->GetBlocks()[(local[0] * sectionSide + j) * sectionSide + k];
+					}
+					else
+					{
+						blockType = volume.Get(i, j, k);
+						visible = blockType != BlockType::AIR && CheckIfNeighboorIsAir(direction, volume, i, j, k, *data);
+					}
+
+					uint64 key = 0;
+					if (visible)
+					{
+						key = uint64(((int32(blockType) << 16) | GetTextureIndex(direction, blockType, *data)) + 1) |
+							(uint64(GetCornerLights(volume, direction, i, j, k, *data)) << 32);
+					}
+
+					mask[v * sectionSide + u] = key;
+					maskBlocks[v * sectionSide + u] = blockType;
+				}
+			}
+
+			for (int32 v = 0; v < sectionSide; v++)
+			{
+				for (int32 u = 0; u < sectionSide; )
+				{
+					uint64 key = mask[v * sectionSide + u];
+					if (key == 0) { u++; continue; }
+
+					// Grow along u first, then along v while the whole row matches
+					int32 width = 1;
+					while (u + width < sectionSide && mask[v * sectionSide + u + width] == key) width++;
+
+					int32 height = 1;
+					for (; v + height < sectionSide; height++)
+					{
+						bool rowMatches = true;
+						for (int32 w = 0; w < width && rowMatches; w++)
+							rowMatches = mask[(v + height) * sectionSide + u + w] == key;
+						if (!rowMatches) break;
+					}
+
+					for (int32 h = 0; h < height; h++)
+						for (int32 w = 0; w < width; w++)
+							mask[(v + h) * sectionSide + u + w] = 0;
+
+					int32 extent[3];
+					extent[normalAxis] = 1; extent[uAxis] = width; extent[vAxis] = height;
+					local[uAxis] = u; local[vAxis] = v;
+
+					AddGreedyFace(direction, maskBlocks[v * sectionSide + u], data,
+						sectionID * sectionSide + local[0], local[1], local[2],
+						extent[0], extent[1], extent[2], uint16(key >> 32));
+
+					u += width;
+				}
+			}
+		}
+	}
+}
+
+bool AChunk::IsSectionHidden(const FChunkVolumeView& volume, int32 section)
 {
+	const FChunkBlockStorage& blocks = volume.GetBlocks();
+	const FChunkBorders* borders = volume.GetBorders();
+
+	if (blocks.IsSectionEmpty(section)) return true;
+	if (!blocks.IsSectionOpaque(section)) return false;
+
+	// The faces at the top and bottom of the world are never emitted
+	if (section + 1 < blocks.GetSectionCount() && !blocks.IsSectionFaceOpaque(section + 1, MeshData::DOWN)) return false;
+	if (section > 0 && !blocks.IsSectionFaceOpaque(section - 1, MeshData::UP)) return false;
+
+	for (int d = MeshData::LEFT; d <= MeshData::BACK; d++)
+	{
+		if (!borders || !borders->IsLoaded(MeshData::Direction(d))) return false;
+		if (!(borders->opaqueSections[d - MeshData::LEFT] & (1u << section))) return false;
+	}
+
+	return true;
+}
+
+bool AChunk::CheckIfNeighboorIsAir(MeshData::Direction direction, const FChunkVolumeView& volume, int i, int j, int k,
+	MeshData& data)
+{
+	int sectionCount = volume.GetSectionCount(), sectionSide = volume.GetSectionSide();
+	const FChunkBorders* borders = volume.GetBorders();
+
 	FVector offset = data.NORMALS[direction];
 	int newI = i + offset.Z, newJ = j + offset.Y, newK = k + offset.X;
 
-	// TODO: Handle interchunk check
 	if (newI >= sectionCount * sectionSide || newI < 0) return false;
-	if (newJ >= sectionSide || newJ < 0) return false;
-	if (newK >= sectionSide || newK < 0) return false;
+
+	// Chunk walls, look at the neighbor chunk, if it's not loaded yet the face is exposed
+	if (newJ >= sectionSide || newJ < 0 || newK >= sectionSide || newK < 0)
+	{
+		if (!borders || !borders->IsLoaded(direction)) return true;
+
+		int along = (direction == MeshData::LEFT || direction == MeshData::RIGHT) ? j : k;
+		return !FBlockRegistry::IsOpaque(borders->Get(direction, i, along, sectionSide));
+	}
 
 	//UE_LOG(LogTemp, Log, TEXT("%d %d %d -> %d %d %d: %d: %s"),
 	//	i, j, k, newI, newJ, newK,
 	//	direction,
 	//	(blocks[GetPositionInTArray(newI, newJ, newK)] == BlockType::AIR) ? TEXT("TRUE") : TEXT("FALSE"))
 
-	return blocks[GetPositionInTArray(newI,newJ,newK, sectionSide)] == BlockType::AIR;
+	return !FBlockRegistry::IsOpaque(volume.Get(newI, newJ, newK));
 }
 
 void AChunk::AddVoxel(FVector insidePoint, BlockType blockTypeToAdd)
@@ -186,157 +497,473 @@ void AChunk::AddVoxel(FVector insidePoint, BlockType blockTypeToAdd)
 	int j = int(insidePoint.Y) / BlockSize;
 	int i = int(insidePoint.Z) / BlockSize;
 
-	int positionInTArray = GetPositionInTArray(i, j, k, mSectionSide);
+	SetVoxel(i, j, k, blockTypeToAdd);
+}
+
+void AChunk::RemoveVoxel(FVector insidePoint)
+{
+	int k = int(insidePoint.X) / BlockSize;
+	int j = int(insidePoint.Y) / BlockSize;
+	int i = int(insidePoint.Z) / BlockSize;
+
+	SetVoxel(i, j, k, BlockType::AIR);
+}
 
-	// TODO: Handle interchunk check
+void AChunk::SetVoxel(int i, int j, int k, BlockType blockType)
+{
 	if (i >= mSectionCount * mSectionSide || i < 0) return;
 	if (j >= mSectionSide || j < 0) return;
 	if (k >= mSectionSide || k < 0) return;
 
-	UE_LOG(LogTemp, Log, TEXT("Blocks Size %d %d %d"), mBlocks.Num(), &mBlocks, this);
+	mBlocks.Set(i, j, k, blockType);
+	mModified = true;
+	if (mHasCollision) mCollisionDirty = true;
 
-	mBlocks[positionInTArray] = blockTypeToAdd;
+	// Marks the sections whose faces see a different light, here and in the neighbors
+	FChunkLighting::UpdateBlock(this, i, j, k);
 
-	// TODO: Handle interchunk compute
 	// Reconstruct the current section
 	int32 section = i / mSectionSide;
+	MarkSectionDirty(section, true);
 
 	// Check if section above or below needs update (current i is right at the edge)
-	if (i % mSectionSide == 0 || (i + 1) % mSectionSide == 0)
+	if (i % mSectionSide == 0) MarkSectionDirty(section - 1, true);
+	if ((i + 1) % mSectionSide == 0) MarkSectionDirty(section + 1, true);
+
+	// The neighbor chunks culled their wall faces against this block
+	for (int d = MeshData::LEFT; d <= MeshData::BACK; d++)
 	{
-		int32 extraSection = i % mSectionSide == 0 ? section - 1 : section + 1;
+		bool onWall = (d == MeshData::LEFT && k == 0) || (d == MeshData::RIGHT && k == mSectionSide - 1) ||
+			(d == MeshData::FORWARD && j == 0) || (d == MeshData::BACK && j == mSectionSide - 1);
+		if (!onWall || FindChunk(mChunkX, mChunkY) != this) continue;
 
-		MeshData* d = GetMeshData(0, 0, extraSection, mSectionCount, mBlocks, mSectionSide);
-		mesh->ClearMeshSection(extraSection);
-		mesh->CreateMeshSection_LinearColor(extraSection, d->vertices, d->Triangles, d->normals, d->UV0, d->vertexColors, d->tangents, true);
+		AChunk* neighbor = FindChunk(mChunkX + NEIGHBOR_OFFSETS[d - MeshData::LEFT][0], mChunkY + NEIGHBOR_OFFSETS[d - MeshData::LEFT][1]);
+		if (neighbor) neighbor->MarkSectionDirty(section, true);
+	}
+}
 
-		delete(d);
+void AChunk::MarkSectionDirty(int32 section, bool urgent)
+{
+	if (section < 0 || section >= mSectionCount) return;
+
+	if (mDirtySections == 0) DirtyChunks.AddUnique(this);
+
+	mDirtySections |= 1u << section;
+	if (urgent) mUrgentSections |= 1u << section;
+	mSectionVersions[section]++;
+}
+
+// Creating a section over an existing one replaces it in place, sections without geometry
+// are cleared instead so pooled chunks don't keep their old faces
+void AChunk::UploadSection(int32 section, MeshData* d)
+{
+	if (FindChunk(mChunkX, mChunkY) == this)
+		VisibilityGraph.SetSection(mChunkX, mChunkY, section, mSectionCount, d->connectivity);
 
-		UE_LOG(LogTemp, Log, TEXT("Extra section updated i: %d, extraSection: %d"), i, extraSection);
+	if (d->quads.Num() == 0)
+	{
+		mesh->ClearMeshSection(section);
+		return;
 	}
 
-	MeshData* d = GetMeshData(0, 0, section, mSectionCount, mBlocks, mSectionSide);
-	mesh->ClearMeshSection(section);
-	mesh->CreateMeshSection_LinearColor(section, d->vertices, d->Triangles, d->normals, d->UV0, d->vertexColors, d->tangents, true);
-	delete(d);
+	// Only used on the game thread, kept between uploads so the vertex arrays aren't allocated every time
+	static FChunkMeshBuffers buffers;
+	ExpandMeshData(*d, buffers);
+
+	mesh->CreateMeshSection_LinearColor(section, buffers.vertices, buffers.Triangles, buffers.normals,
+		buffers.UV0, buffers.vertexColors, buffers.tangents, false);
+
+	// New sections are always visible
+	if (!(mVisibleSections & (1u << section))) mesh->SetMeshSectionVisible(section, false);
 }
 
-void AChunk::RemoveVoxel(FVector insidePoint)
+void AChunk::SetCollisionBoxes(const TArray<FBox>& boxes)
 {
-	int k = int(insidePoint.X) / BlockSize;
-	int j = int(insidePoint.Y) / BlockSize;
-	int i = int(insidePoint.Z) / BlockSize;
+	TArray<TArray<FVector>> convexMeshes;
+	convexMeshes.SetNum(boxes.Num());
 
-	int positionInTArray = GetPositionInTArray(i, j, k, mSectionSide);
-	// TODO: Handle interchunk check
-	if (i >= mSectionCount*mSectionSide || i < 0) return;
-	if (j >= mSectionSide || j < 0) return;
-	if (k >= mSectionSide || k < 0) return;
+	for (int32 b = 0; b < boxes.Num(); b++)
+	{
+		convexMeshes[b].Reserve(8);
+		for (int32 corner = 0; corner < 8; corner++)
+		{
+			convexMeshes[b].Add(FVector(corner & 1 ? boxes[b].Max.X : boxes[b].Min.X,
+				corner & 2 ? boxes[b].Max.Y : boxes[b].Min.Y, corner & 4 ? boxes[b].Max.Z : boxes[b].Min.Z));
+		}
+	}
 
-	//UE_LOG(LogTemp, Log, TEXT("Blocks Size %d %d %d"), mBlocks.Num(), &mBlocks, this);
+	mesh->SetCollisionConvexMeshes(convexMeshes);
+}
 
-	mBlocks[positionInTArray] = BlockType::AIR;
+void AChunk::ClearCollision()
+{
+	if (mHasCollision) mesh->ClearCollisionConvexMeshes();
 
-	// TODO: Handle interchunk compute
-	// Reconstruct the current section
-	int32 section = i / mSectionSide;
+	mHasCollision = false; mCollisionDirty = false;
+	mCollisionVersion++;
+}
 
-	UE_LOG(LogTemp, Log, TEXT("Removing voxel %d %d %d, at section: %d"), i, j, k, section)
+void AChunk::SetVisibleSections(uint32 visibleSections)
+{
+	uint32 changed = visibleSections ^ mVisibleSections;
+	mVisibleSections = visibleSections;
 
-	// Check if section above or below needs update (current i is right at the edge)
-	if (i % mSectionSide == 0 || (i + 1) % mSectionSide == 0)
+	while (changed)
+	{
+		int32 section = FMath::CountTrailingZeros(changed);
+		changed &= changed - 1;
+
+		if (section < mesh->GetNumSections()) mesh->SetMeshSectionVisible(section, (visibleSections & (1u << section)) != 0);
+	}
+}
+
+void AChunk::UpdateSectionVisibility(const FVector& cameraLocation, int32 maxDistance)
+{
+	CHUNK_STAGE_SCOPE(STAT_ChunkVisibility, Visibility);
+
+	static int32 lastChunkX = 0, lastChunkY = 0, lastSection = -1;
+	static uint32 lastVersion = 0;
+	static bool lastCulling = false;
+
+	int32 chunkX = floor(cameraLocation.X / 1600.0f);
+	int32 chunkY = floor(cameraLocation.Y / 1600.0f);
+
+	AChunk* cameraChunk = FindChunk(chunkX, chunkY);
+	int32 section = cameraChunk ?
+		FMath::FloorToInt((cameraLocation.Z - GetChunkOrigin(chunkX, chunkY).Z) / (cameraChunk->mSectionSide * BlockSize)) : -1;
+
+	bool culling = GCaveCulling != 0;
+	if (chunkX == lastChunkX && chunkY == lastChunkY && section == lastSection && culling == lastCulling &&
+		VisibilityGraph.GetVersion() == lastVersion)
+	{
+		return;
+	}
+
+	lastChunkX = chunkX; lastChunkY = chunkY; lastSection = section;
+	lastCulling = culling; lastVersion = VisibilityGraph.GetVersion();
+
+	// Outside of the loaded sections, above the world for example, nothing is hidden
+	TMap<int64, uint32> visibleSections;
+	culling = culling && VisibilityGraph.FindVisibleSections(chunkX, chunkY, section, maxDistance, visibleSections);
+
+	VisibleSectionCount = 0; LoadedSectionCount = 0;
+	TArray<AChunk*> chunks;
+	ChunkRegistry.GetChunks(chunks);
+	for (AChunk* chunk : chunks)
+	{
+		uint32 allSections = chunk->mSectionCount >= 32 ? ~0u : (1u << chunk->mSectionCount) - 1;
+		uint32 visible = culling ? visibleSections.FindRef(FSectionVisibilityGraph::GetKey(chunk->mChunkX, chunk->mChunkY)) : ~0u;
+
+		chunk->SetVisibleSections(visible);
+		VisibleSectionCount += FMath::CountBits(visible & allSections);
+		LoadedSectionCount += chunk->mSectionCount;
+	}
+}
+
+void AChunk::Remesh()
+{
+	FChunkBorders borders = GetBorders();
+	mNeighborsLoaded = borders.loadedMask;
+
+	for (int32 section = 0; section < mSectionCount; section++)
+		MarkSectionDirty(section);
+
+	UE_LOG(LogTemp, Verbose, TEXT("Remeshed chunk %d %d with neighbors %d"), mChunkX, mChunkY, mNeighborsLoaded);
+}
+
+// Chunks that are not in the ChunkRegistry (ie. created from Blueprints) have no neighbors
+FChunkBorders AChunk::GetBorders() const
+{
+	if (FindChunk(mChunkX, mChunkY) != this) return FChunkBorders();
+
+	return GetChunkBorders(mChunkX, mChunkY);
+}
+
+FChunkBorders AChunk::GetChunkBorders(int32 ChunkX, int32 ChunkY)
+{
+	FChunkBorders borders;
+
+	for (int d = MeshData::LEFT; d <= MeshData::BACK; d++)
+	{
+		AChunk* neighbor = FindChunk(ChunkX + NEIGHBOR_OFFSETS[d - MeshData::LEFT][0], ChunkY + NEIGHBOR_OFFSETS[d - MeshData::LEFT][1]);
+		if (neighbor) borders.SetNeighbor(MeshData::Direction(d), neighbor->mBlocks, &neighbor->mLight);
+	}
+
+	return borders;
+}
+
+void FChunkBorders::SetNeighbor(MeshData::Direction direction, const FChunkBlockStorage& neighbor,
+	const FChunkLightStorage* neighborLight)
+{
+	// The wall of the neighbor that faces this chunk
+	int32 slice = direction - MeshData::LEFT;
+	GetWall(neighbor, neighborLight, direction ^ 1, slices[slice], lightSlices[slice], opaqueSections[slice]);
+	loadedMask |= 1 << slice;
+}
+
+void FChunkBorders::SetNeighbor(MeshData::Direction direction, const FChunkBorders& neighborWalls)
+{
+	int32 wall = (direction ^ 1) - MeshData::LEFT;
+	slices[direction - MeshData::LEFT] = neighborWalls.slices[wall];
+	lightSlices[direction - MeshData::LEFT] = neighborWalls.lightSlices[wall];
+	opaqueSections[direction - MeshData::LEFT] = neighborWalls.opaqueSections[wall];
+	loadedMask |= 1 << (direction - MeshData::LEFT);
+}
+
+FChunkBorders FChunkBorders::GetWalls(const FChunkBlockStorage& blocks, const FChunkLightStorage* light)
+{
+	FChunkBorders walls;
+	for (int32 d = MeshData::LEFT; d <= MeshData::BACK; d++)
+	{
+		int32 slice = d - MeshData::LEFT;
+		GetWall(blocks, light, d, walls.slices[slice], walls.lightSlices[slice], walls.opaqueSections[slice]);
+	}
+
+	walls.loadedMask = 0xF;
+	return walls;
+}
+
+void FChunkBorders::GetWall(const FChunkBlockStorage& blocks, const FChunkLightStorage* light, int32 wall,
+	TArray<BlockType>& slice, TArray<uint8>& lightSlice, uint32& opaqueSections)
+{
+	int side = blocks.GetSectionSide(), height = blocks.GetSectionCount() * side;
+	slice.SetNumUninitialized(height * side);
+
+	bool withLight = light && !light->IsEmpty();
+	if (withLight) lightSlice.SetNumUninitialized(height * side);
+	else lightSlice.Reset();
+
+	for (int i = 0; i < height; i++)
+	{
+		for (int along = 0; along < side; along++)
+		{
+			int j = along, k = along;
+			if (wall == MeshData::LEFT) k = 0;
+			else if (wall == MeshData::RIGHT) k = side - 1;
+			else if (wall == MeshData::FORWARD) j = 0;
+			else j = side - 1;
+
+			slice[i * side + along] = blocks.Get(i, j, k);
+			if (withLight) lightSlice[i * side + along] = light->Get(i, j, k);
+		}
+	}
+
+	// Sections whose face on that side is all opaque
+	opaqueSections = 0;
+	for (int32 section = 0; section < blocks.GetSectionCount(); section++)
+	{
+		if (blocks.IsSectionFaceOpaque(section, wall))
+			opaqueSections |= 1u << section;
+	}
+}
+
+AChunk* AChunk::FindChunk(int32 ChunkX, int32 ChunkY)
+{
+	return ChunkRegistry.Find(ChunkX, ChunkY);
+}
+
+bool FChunkVolumeView::GetLightSample(int i, int j, int k, uint8& light) const
+{
+	int32 side = GetSectionSide(), height = side * GetSectionCount();
+	if (i < 0) return false;
+	if (i >= height)
+	{
+		light = FChunkLightStorage::MaxLight;
+		return true;
+	}
+
+	bool outJ = j < 0 || j >= side, outK = k < 0 || k >= side;
+	if (!outJ && !outK)
 	{
-		int32 extraSection = i % mSectionSide == 0 ? section - 1 : section + 1;
+		if (FBlockRegistry::IsOpaque(Get(i, j, k))) return false;
+
+		light = FChunkLightStorage::GetBrightness(mLight->Get(i, j, k));
+		return true;
+	}
 
-		MeshData* d = GetMeshData(0,0, extraSection, mSectionCount, mBlocks, mSectionSide);
-		mesh->ClearMeshSection(extraSection);
-		mesh->CreateMeshSection_LinearColor(extraSection, d->vertices, d->Triangles, d->normals, d->UV0, d->vertexColors, d->tangents, true);
+	// Diagonal chunks aren't in the borders
+	if (outJ && outK) return false;
 
-		delete(d);
+	MeshData::Direction direction = k < 0 ? MeshData::LEFT : k >= side ? MeshData::RIGHT : j < 0 ? MeshData::FORWARD : MeshData::BACK;
+	if (!mBorders || !mBorders->IsLoaded(direction) || mBorders->lightSlices[direction - MeshData::LEFT].Num() == 0) return false;
+
+	int along = outK ? j : k;
+	if (FBlockRegistry::IsOpaque(mBorders->Get(direction, i, along, side))) return false;
+
+	light = FChunkLightStorage::GetBrightness(mBorders->GetLight(direction, i, along, side));
+	return true;
+}
 
-		UE_LOG(LogTemp, Log, TEXT("Extra section updated i: %d, extraSection: %d"), i, extraSection);
+uint16 AChunk::GetCornerLights(const FChunkVolumeView& volume, MeshData::Direction direction,
+	int i, int j, int k, const MeshData& data)
+{
+	if (!volume.GetLight()) return 0xFFFF;
+
+	int32 uAxis = SLICE_AXES[direction][0], vAxis = SLICE_AXES[direction][1];
+	FVector normal = data.NORMALS[direction];
+
+	// The 3x3 blocks in front of the face, centered on the one it looks at
+	uint8 samples[3][3];
+	bool valid[3][3];
+	for (int32 v = 0; v < 3; v++)
+	{
+		for (int32 u = 0; u < 3; u++)
+		{
+			int32 position[3] = { i + int32(normal.Z), j + int32(normal.Y), k + int32(normal.X) };
+			position[uAxis] += u - 1; position[vAxis] += v - 1;
+			valid[v][u] = volume.GetLightSample(position[0], position[1], position[2], samples[v][u]);
+		}
 	}
 
-	MeshData* d = GetMeshData(0,0,section, mSectionCount, mBlocks, mSectionSide);
-	mesh->ClearMeshSection(section);
-	mesh->CreateMeshSection_LinearColor(section, d->vertices, d->Triangles, d->normals, d->UV0, d->vertexColors, d->tangents, true);
+	uint16 cornerLights = 0;
+	for (int32 corner = 0; corner < 4; corner++)
+	{
+		// Vertices are in xyz, the axes in ijk
+		const FVector& vertex = data.VERTICES[direction][corner];
+		double vertexIJK[3] = { vertex.Z, vertex.Y, vertex.X };
+		int32 u = vertexIJK[uAxis] > 0.5 ? 2 : 0, v = vertexIJK[vAxis] > 0.5 ? 2 : 0;
+
+		// The diagonal block can't light the corner through two solid ones
+		int32 total = 0, count = 0;
+		auto AddSample = [&](int32 sampleV, int32 sampleU)
+		{
+			if (valid[sampleV][sampleU]) { total += samples[sampleV][sampleU]; count++; }
+		};
+		AddSample(1, 1); AddSample(1, u); AddSample(v, 1);
+		if (valid[1][u] || valid[v][1]) AddSample(v, u);
 
-	delete(d);
+		uint32 light = count > 0 ? (total + count / 2) / count : FPackedQuad::MaxLight;
+		cornerLights |= uint16(light << (corner * 4));
+	}
+
+	return cornerLights;
 }
 
 void AChunk::AddVoxelFace(MeshData::Direction direction,
 	BlockType currentBlockType,
 	MeshData* data,
-	int i, int j, int k)
+	int i, int j, int k,
+	uint16 cornerLights)
+{
+	data->quads.Add(FPackedQuad::Pack(direction, GetTextureIndex(direction, currentBlockType, *data),
+		i - data->sectionID * data->sectionSide, j, k, 1, 1, 1, cornerLights));
+}
+
+void AChunk::AddSkirts(const FChunkVolumeView& volume, int32 sectionID, MeshData* data)
 {
-	FDateTime start = FDateTime::UtcNow();
+	const FChunkBorders* borders = volume.GetBorders();
+	if (!borders) return;
+
+	int32 sectionSide = volume.GetSectionSide(), height = sectionSide * volume.GetSectionCount();
+	int32 initialI = sectionID * sectionSide, lastI = initialI + sectionSide;
 
+	for (int d = MeshData::LEFT; d <= MeshData::BACK; d++)
+	{
+		// Not loaded neighbors have every wall face emitted already
+		MeshData::Direction direction = MeshData::Direction(d);
+		if (!borders->IsLoaded(direction)) continue;
+
+		for (int along = 0; along < sectionSide; along++)
+		{
+			int j = along, k = along;
+			if (d == MeshData::LEFT) k = 0;
+			else if (d == MeshData::RIGHT) k = sectionSide - 1;
+			else if (d == MeshData::FORWARD) j = 0;
+			else j = sectionSide - 1;
+
+			int top = height - 1;
+			while (top >= 0 && volume.Get(top, j, k) == BlockType::AIR) top--;
+
+			int from = FMath::Max(top - SKIRT_CELLS + 1, initialI), to = FMath::Min(top + 1, lastI);
+			for (int i = from; i < to; i++)
+			{
+				BlockType blockType = volume.Get(i, j, k);
+				if (blockType == BlockType::AIR || !FBlockRegistry::IsOpaque(borders->Get(direction, i, along, sectionSide))) continue;
+
+				AddVoxelFace(direction, blockType, data, i, j, k);
+			}
+		}
+	}
+}
+
+// Same as AddVoxelFace but the quad covers extentI x extentJ x extentK blocks (one of them is 1)
+void AChunk::AddGreedyFace(MeshData::Direction direction,
+	BlockType currentBlockType,
+	MeshData* data,
+	int i, int j, int k,
+	int extentI, int extentJ, int extentK,
+	uint16 cornerLights)
+{
+	data->quads.Add(FPackedQuad::Pack(direction, GetTextureIndex(direction, currentBlockType, *data),
+		i - data->sectionID * data->sectionSide, j, k, extentI, extentJ, extentK, cornerLights));
+}
+
+// Per face meshes get the atlas UVs of their tile. Greedy quads get UV0 counting blocks along the quad
+// so the tile repeats instead of stretching, and the atlas cell goes in the vertex color alpha since
+// a single UV range can't repeat a cell inside the atlas
+void AChunk::ExpandMeshData(const MeshData& data, FChunkMeshBuffers& out)
+{
 	const int numVertices = 4;
-	int lastNumVertices = data->vertices.Num();
-	FVector position = FVector(k * BlockSize, j * BlockSize, i * BlockSize);
-
-	// VERTICES
-	for (int v = 0; v < numVertices; v++) data->vertices.Add(data->VERTICES[direction][v]*100 + position);
-
-	// TRIANGLES
-	data->Triangles.Add(lastNumVertices + 0);
-	data->Triangles.Add(lastNumVertices + 1);
-	data->Triangles.Add(lastNumVertices + 2);
-	data->Triangles.Add(lastNumVertices + 3);
-	data->Triangles.Add(lastNumVertices + 2);
-	data->Triangles.Add(lastNumVertices + 1);
-
-	// NORMALS
-	for (int v = 0; v < numVertices; v++) data->normals.Add(data->NORMALS[direction]);
-
-	auto getUVIndices = [data](int32 index, int32& outUVI, int32& outUVJ)
-	{
-		outUVI = index / data->ATLAS_SIZE;
-		outUVJ = index % data->ATLAS_SIZE;
-	};
-
-	// UVI -> rows -> V, UVJ -> columns -> U
-	int UVI = 0;
-	int UVJ = 0;
-	float UVSize = 1.0f / data->ATLAS_SIZE;
-	switch (direction)
-	{
-	case MeshData::UP:
-		getUVIndices(data->BlockTypeTextureIndex[int(currentBlockType)][0], UVI, UVJ);
-		break;
-	case MeshData::DOWN:
-		getUVIndices(data->BlockTypeTextureIndex[int(currentBlockType)][2], UVI, UVJ);
-		break;
-	case MeshData::RIGHT:
-		getUVIndices(data->BlockTypeTextureIndex[int(currentBlockType)][1], UVI, UVJ);
-		break;
-	case MeshData::LEFT:
-		getUVIndices(data->BlockTypeTextureIndex[int(currentBlockType)][1], UVI, UVJ);
-		break;
-	case MeshData::FORWARD:
-		getUVIndices(data->BlockTypeTextureIndex[int(currentBlockType)][1], UVI, UVJ);
-		break;
-	case MeshData::BACK:
-		getUVIndices(data->BlockTypeTextureIndex[int(currentBlockType)][1], UVI, UVJ);
-		break;
-	}
-		
-	// UVs
-	// TODO: Make the texture mapping to use RHI
-	// TODO: Make the lighting more efficient
-	data->UV0.Add(data->UVS_Inverted[direction][0] * UVSize + FVector2D(UVJ * UVSize, UVI * UVSize));
-	data->UV0.Add(data->UVS_Inverted[direction][1] * UVSize + FVector2D(UVJ * UVSize, UVI * UVSize));
-	data->UV0.Add(data->UVS_Inverted[direction][2] * UVSize + FVector2D(UVJ * UVSize, UVI * UVSize));
-	data->UV0.Add(data->UVS_Inverted[direction][3] * UVSize + FVector2D(UVJ * UVSize, UVI * UVSize));
-
-	//TANGENTS
-	for (int v = 0; v < numVertices; v++) data->tangents.Add(data->TANGENTS[direction]);
-
-	// VERTEX COLOR
-	data->vertexColors.Add(FLinearColor(0.75, 0.75, 0.75, 1.0));
-	data->vertexColors.Add(FLinearColor(0.75, 0.75, 0.75, 1.0));
-	data->vertexColors.Add(FLinearColor(0.75, 0.75, 0.75, 1.0));
-	data->vertexColors.Add(FLinearColor(0.75, 0.75, 0.75, 1.0));
+	// Vertex color of a corner with full light, every level below that is 20% darker
+	const float LIT_COLOR = 0.75f;
+	float lightCurve[FPackedQuad::MaxLight + 1];
+	for (uint32 level = 0; level <= FPackedQuad::MaxLight; level++)
+		lightCurve[level] = LIT_COLOR * FMath::Pow(0.8f, float(FPackedQuad::MaxLight - level));
+
+	out.Reset();
+	out.vertices.Reserve(data.GetVertexCount()); out.Triangles.Reserve(data.GetTriangleCount() * 3);
+	out.normals.Reserve(data.GetVertexCount()); out.UV0.Reserve(data.GetVertexCount());
+	out.tangents.Reserve(data.GetVertexCount()); out.vertexColors.Reserve(data.GetVertexCount());
+
+	bool greedy = data.meshingMode == MeshingMode::GREEDY;
+	int32 baseI = data.sectionID * data.sectionSide;
+	float UVSize = 1.0f / data.ATLAS_SIZE;
+	int32 cellSize = BlockSize * data.lodScale;
+
+	for (const FPackedQuad& quad : data.quads)
+	{
+		MeshData::Direction direction = MeshData::Direction(quad.GetDirection());
+		int lastNumVertices = out.vertices.Num();
+		FVector position = FVector(quad.GetK() * cellSize, quad.GetJ() * cellSize, (baseI + quad.GetLocalI()) * cellSize);
+		FVector extent = FVector(quad.GetExtentK(), quad.GetExtentJ(), quad.GetExtentI());
+
+		// UVI -> rows -> V, UVJ -> columns -> U
+		int32 textureIndex = quad.GetTile();
+		FVector2D cellOffset = FVector2D((textureIndex % data.ATLAS_SIZE) * UVSize, (textureIndex / data.ATLAS_SIZE) * UVSize);
+		FVector2D repeat = FVector2D(extent[data.UV_AXES[direction][0]], extent[data.UV_AXES[direction][1]]) * data.lodScale;
+
+		for (int v = 0; v < numVertices; v++)
+		{
+			out.vertices.Add(data.VERTICES[direction][v] * extent * cellSize + position);
+			out.normals.Add(data.NORMALS[direction]);
+			out.tangents.Add(data.TANGENTS[direction]);
+
+			float light = lightCurve[quad.GetCornerLight(v)];
+			if (greedy)
+			{
+				out.UV0.Add(data.UVS_Inverted[direction][v] * repeat);
+				out.vertexColors.Add(FLinearColor(light, light, light, textureIndex / 255.0f));
+			}
+			else
+			{
+				out.UV0.Add(data.UVS_Inverted[direction][v] * UVSize + cellOffset);
+				out.vertexColors.Add(FLinearColor(light, light, light, 1.0));
+			}
+		}
+
+		out.Triangles.Add(lastNumVertices + 0);
+		out.Triangles.Add(lastNumVertices + 1);
+		out.Triangles.Add(lastNumVertices + 2);
+		out.Triangles.Add(lastNumVertices + 3);
+		out.Triangles.Add(lastNumVertices + 2);
+		out.Triangles.Add(lastNumVertices + 1);
+	}
+}
+
+// Atlas index of the texture used by the given face of the block
+int32 AChunk::GetTextureIndex(MeshData::Direction direction, BlockType blockType, const MeshData& data)
+{
+	return FBlockRegistry::GetTile(blockType, direction);
 }
 
 // Given an i, j, k position, return the position in the resulting block array
@@ -405,13 +1032,148 @@ void AChunk::Tick(float DeltaTime)
 
 }
 
-TArray<MeshData*> AChunk::GetMeshDataForChunk(int32 ChunkX, int32 ChunkY, 
-	TFunction <BlockType(int32 i, int32 j, int32 k)> PopulateBlock)
+TUniquePtr<FChunkBuildResult> AChunk::BuildChunk(int32 ChunkX, int32 ChunkY, 
+	const IChunkGenerator& generator, MeshingMode meshingMode, const FChunkBorders* borders, int32 lod)
 {
 	int dummy;
-	TArray<BlockType> blocks = AChunk::GenerateChunkData(ChunkX, ChunkY, 16, 16, dummy, dummy, PopulateBlock);
+	return BuildChunk(ChunkX, ChunkY, AChunk::GenerateChunkData(ChunkX, ChunkY, 16, 16, dummy, dummy, generator), meshingMode, borders, lod);
+}
+
+TUniquePtr<FChunkBuildResult> AChunk::BuildChunk(int32 ChunkX, int32 ChunkY,
+	FChunkBlockStorage&& blocks, MeshingMode meshingMode, const FChunkBorders* borders, int32 lod,
+	FChunkLightStorage&& light)
+{
+	TUniquePtr<FChunkBuildResult> result = MakeUnique<FChunkBuildResult>();
+	result->chunkX = ChunkX; result->chunkY = ChunkY;
+	result->meshingMode = meshingMode;
+	result->neighborsLoaded = borders ? borders->loadedMask : 0;
+	result->lod = lod;
+
+	result->blocks = MoveTemp(blocks);
+	result->light = MoveTemp(light);
+	if (result->light.IsEmpty()) FChunkLighting::Compute(result->blocks, result->light);
+
+	if (lod == 0)
+	{
+		result->sections = AChunk::GetMeshDataForChunk(ChunkX, ChunkY, FChunkVolumeView(result->blocks, borders, &result->light), meshingMode);
+		return result;
+	}
+
+	// The chunk keeps the full blocks and light, only the mesh is downsampled and it's fully lit
+	FChunkBlockStorage cells = FChunkLod::Downsample(result->blocks, lod);
+	FChunkBorders cellBorders = borders ? FChunkLod::DownsampleBorders(*borders, result->blocks.GetSectionSide(), lod) : FChunkBorders();
+	result->sections = AChunk::GetMeshDataForChunk(ChunkX, ChunkY, FChunkVolumeView(cells, borders ? &cellBorders : nullptr), meshingMode, lod);
+
+	return result;
+}
+
+void AChunk::LogMeshingComparison(int32 ChunkX, int32 ChunkY, const IChunkGenerator& generator)
+{
+	int32 sectionSide, sectionCount;
+	double generationStart = FPlatformTime::Seconds();
+	FChunkBlockStorage blocks = AChunk::GenerateChunkData(ChunkX, ChunkY, 16, 16, sectionSide, sectionCount, generator);
+
+	UE_LOG(LogTemp, Log, TEXT("Chunk %d %d: generated in %.1f us"), ChunkX, ChunkY, (FPlatformTime::Seconds() - generationStart) * 1000000.0);
+
+	int32 totalVertices[2] = { 0, 0 }, totalTriangles[2] = { 0, 0 };
+	SIZE_T totalQuadBytes[2] = { 0, 0 };
+	double totalSeconds[2] = { 0.0, 0.0 };
+
+	for (int32 section = 0; section < sectionCount; section++)
+	{
+		MeshData* perFace = GetMeshData(ChunkX, ChunkY, section, FChunkVolumeView(blocks), MeshingMode::PER_FACE);
+		MeshData* greedy = GetMeshData(ChunkX, ChunkY, section, FChunkVolumeView(blocks), MeshingMode::GREEDY);
 
-	return AChunk::GetMeshDataForChunk(ChunkX, ChunkY, 16, blocks, 16);
+		UE_LOG(LogTemp, Log, TEXT("Section %2d: PER_FACE %6d vertices %6d triangles %.3f ms | GREEDY %6d vertices %6d triangles %.3f ms"),
+			section,
+			perFace->GetVertexCount(), perFace->GetTriangleCount(), perFace->meshingSeconds * 1000.0,
+			greedy->GetVertexCount(), greedy->GetTriangleCount(), greedy->meshingSeconds * 1000.0);
+
+		MeshData* results[2] = { perFace, greedy };
+		for (int32 m = 0; m < 2; m++)
+		{
+			totalVertices[m] += results[m]->GetVertexCount();
+			totalTriangles[m] += results[m]->GetTriangleCount();
+			totalQuadBytes[m] += results[m]->quads.GetAllocatedSize();
+			totalSeconds[m] += results[m]->meshingSeconds;
+		}
+
+		FMeshDataPool::Release(perFace); FMeshDataPool::Release(greedy);
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Chunk %d %d: PER_FACE %d vertices %d triangles %.3f ms/section | GREEDY %d vertices %d triangles %.3f ms/section"),
+		ChunkX, ChunkY,
+		totalVertices[0], totalTriangles[0], totalSeconds[0] * 1000.0 / sectionCount,
+		totalVertices[1], totalTriangles[1], totalSeconds[1] * 1000.0 / sectionCount);
+
+	// What the same meshes took with one FVector, normal, UV, tangent, color and the indices per vertex
+	const int32 EXPANDED_BYTES_PER_QUAD = 4 * (sizeof(FVector) * 2 + sizeof(FVector2D) + sizeof(FProcMeshTangent) + sizeof(FLinearColor)) + 6 * sizeof(int32);
+	UE_LOG(LogTemp, Log, TEXT("Chunk %d %d: packed quads PER_FACE %d bytes GREEDY %d bytes, %d and %d bytes expanded"),
+		ChunkX, ChunkY, int32(totalQuadBytes[0]), int32(totalQuadBytes[1]),
+		totalTriangles[0] / 2 * EXPANDED_BYTES_PER_QUAD, totalTriangles[1] / 2 * EXPANDED_BYTES_PER_QUAD);
+
+	UE_LOG(LogTemp, Log, TEXT("Chunk %d %d: block storage %d bytes, %d bytes as a flat array"),
+		ChunkX, ChunkY, int32(blocks.GetAllocatedSize()), sectionCount * sectionSide * sectionSide * sectionSide * int32(sizeof(BlockType)));
+}
+
+void AChunk::LogMesherBenchmark(int32 ChunkX, int32 ChunkY, const IChunkGenerator& generator, int32 iterations)
+{
+	int32 sectionSide, sectionCount;
+	FChunkBlockStorage blocks = AChunk::GenerateChunkData(ChunkX, ChunkY, 16, 16, sectionSide, sectionCount, generator);
+	iterations = FMath::Max(iterations, 1);
+
+	int32 previousMesher = GBitmaskMesher;
+	const TCHAR* MESHER_NAMES[2] = { TEXT("scalar"), TEXT("bitmask") };
+
+	// The first iteration of every mesher is kept to compare them
+	TArray<MeshData*> firstResults[2];
+	double totalSeconds[2] = { 0.0, 0.0 };
+
+	for (int32 mesher = 0; mesher < 2; mesher++)
+	{
+		GBitmaskMesher = mesher;
+		for (int32 iteration = 0; iteration < iterations; iteration++)
+		{
+			for (int32 section = 0; section < sectionCount; section++)
+			{
+				MeshData* d = GetMeshData(ChunkX, ChunkY, section, FChunkVolumeView(blocks), MeshingMode::PER_FACE);
+				totalSeconds[mesher] += d->meshingSeconds;
+
+				if (iteration == 0) firstResults[mesher].Add(d);
+				else FMeshDataPool::Release(d);
+			}
+		}
+	}
+
+	GBitmaskMesher = previousMesher;
+
+	int32 mismatches = 0;
+	for (int32 section = 0; section < sectionCount; section++)
+	{
+		const MeshData* scalar = firstResults[0][section];
+		const MeshData* bitmask = firstResults[1][section];
+
+		if (scalar->quads != bitmask->quads)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Section %d: the bitmask mesher gives %d vertices, the scalar one %d"),
+				section, bitmask->GetVertexCount(), scalar->GetVertexCount());
+			mismatches++;
+		}
+
+		FMeshDataPool::Release(firstResults[0][section]); FMeshDataPool::Release(firstResults[1][section]);
+	}
+
+	int32 sectionsMeshed = sectionCount * iterations;
+	for (int32 mesher = 0; mesher < 2; mesher++)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Chunk %d %d: %s mesher %.3f ms/section, %.0f sections/s on one core"),
+			ChunkX, ChunkY, MESHER_NAMES[mesher],
+			totalSeconds[mesher] * 1000.0 / sectionsMeshed,
+			totalSeconds[mesher] > 0.0 ? sectionsMeshed / totalSeconds[mesher] : 0.0);
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Chunk %d %d: bitmask mesher %.2fx faster, %d sections differ"),
+		ChunkX, ChunkY, totalSeconds[1] > 0.0 ? totalSeconds[0] / totalSeconds[1] : 0.0, mismatches);
 }
 
 void AChunk::CreateChunk(int32 ChunkX, int32 ChunkY, UWorld* World)
@@ -439,103 +1201,213 @@ void AChunk::CreateChunk(int32 ChunkX, int32 ChunkY, UWorld* World)
 	//}
 }
 
-TMap<int32, AChunk*> AChunk::ChunkMap;
-TMap<int32, TFuture<TArray<MeshData*>>*> AChunk::chunkResults;
-void AChunk::CreateChunk(int32 ChunkX, int32 ChunkY, UWorld* World, TArray<MeshData*> chunkData)
+FChunkRegistry AChunk::ChunkRegistry;
+TArray<TWeakObjectPtr<AChunk>> AChunk::ChunkPool;
+TArray<TWeakObjectPtr<AChunk>> AChunk::DirtyChunks;
+TSharedPtr<FChunkRegionStore, ESPMode::ThreadSafe> AChunk::RegionStore;
+TArray<int32> AChunk::LodDistances;
+FSectionVisibilityGraph AChunk::VisibilityGraph;
+int32 AChunk::VisibleSectionCount = 0;
+int32 AChunk::LoadedSectionCount = 0;
+int32 AChunk::PlayerChunkX = 0;
+int32 AChunk::PlayerChunkY = 0;
+void AChunk::CreateChunk(UWorld* World, TUniquePtr<FChunkBuildResult> chunk)
 {
-	FVector location = FVector(ChunkX * 1600, ChunkY * 1600, -1000);
-	FRotator rotation = FRotator();
-	const FTransform transform = FTransform(location);
+	AChunk* const newChunk = PlaceChunk(World, *chunk);
+	if (!newChunk) return;
 
-	if (GEngine)
+	// Generate the mesh data by sections, each of sectionSide*sectionSide, start at the bottom
+	for (int32 section = 0; section < chunk->sections.Num(); section++)
 	{
-		const int32 AlwaysAddKey = -1; // Passing -1 means that we will not try and overwrite an   
-									   // existing message, just add a new one  
-		if (World)
-		{
-			AChunk* const newChunk = World->SpawnActor<AChunk>(AChunk::StaticClass(), transform);
+		// Create the section, pooled chunks get their old sections replaced
+		newChunk->UploadSection(section, chunk->sections[section]);
+	}
+	ChunkRegistry.SetState(chunk->chunkX, chunk->chunkY, EChunkState::Uploaded);
 
-			newChunk->mBlocks = TArray<BlockType>(chunkData[0]->blocks);
-			newChunk->mSectionSide = chunkData[0]->sectionSide; newChunk->mSectionCount = chunkData[0]->sectionCount;
+	newChunk->RemeshStaleNeighbors();
+	newChunk->UpdateLod();
+}
 
-			// Generate the mesh data by sections, each of sectionSide*sectionSide, start at the bottom
-			for (int32 section = 0; section < 16; section++)
-			{
-				MeshData* d = chunkData[section];
+AChunk* AChunk::PlaceChunk(UWorld* World, FChunkBuildResult& chunk, uint32* placedVersions)
+{
+	int32 ChunkX = chunk.chunkX, ChunkY = chunk.chunkY;
 
-				// Create the section
-				newChunk->mesh->CreateMeshSection_LinearColor(section, d->vertices, d->Triangles, d->normals, d->UV0, d->vertexColors, d->tangents, true);
+	// The chunk can be requested again while its data waits in the render queue
+	if (FindChunk(ChunkX, ChunkY)) return nullptr;
 
-				if(chunkData[section]) delete(chunkData[section]); 
-			}
+	FVector location = GetChunkOrigin(ChunkX, ChunkY);
+	const FTransform transform = FTransform(location);
 
-			chunkData.Empty();
+	if (!GEngine || !World) return nullptr;
 
-			// Enable collision data
-			newChunk->mesh->ContainsPhysicsTriMeshData(true);
+	AChunk* const newChunk = AcquireChunk(World, transform);
 
-			AChunk::ChunkMap.Add(GetHashFromChunkPosition(ChunkX, ChunkY), newChunk);
-		}
+	newChunk->mBlocks = MoveTemp(chunk.blocks);
+	newChunk->mLight = MoveTemp(chunk.light);
+	newChunk->mSectionSide = newChunk->mBlocks.GetSectionSide(); newChunk->mSectionCount = newChunk->mBlocks.GetSectionCount();
+	newChunk->mChunkX = ChunkX; newChunk->mChunkY = ChunkY;
+	newChunk->mNeighborsLoaded = chunk.neighborsLoaded;
+	newChunk->mModified = false;
+	newChunk->mLod = chunk.lod;
 
-		GEngine->AddOnScreenDebugMessage(AlwaysAddKey, 20.0f, FColor::Yellow, FString::Printf(TEXT("Chunk created %d %d %f %f"), ChunkX, ChunkY, location.X, location.Y));
+	// Every section is uploaded again, which shows it
+	newChunk->mVisibleSections = ~0u;
+	newChunk->SetMeshingMode(chunk.meshingMode);
+
+	ChunkRegistry.Place(ChunkX, ChunkY, newChunk);
+
+	if (placedVersions) FMemory::Memcpy(placedVersions, newChunk->mSectionVersions, sizeof(newChunk->mSectionVersions));
+
+	// It was lit without its neighbors, and they without it
+	FChunkLighting::StitchNeighbors(newChunk);
+
+	// "stat Chunks" has the numbers, this is only for following single chunks
+	UE_LOG(LogTemp, Verbose, TEXT("Chunk created %d %d %f %f"), ChunkX, ChunkY, location.X, location.Y);
+
+	return newChunk;
+}
+
+void AChunk::RemeshStaleNeighbors()
+{
+	// Neighbors that arrived while this chunk was meshing, and neighbors that were meshed
+	// treating this chunk as missing, have walls to remove
+	FChunkBorders borders = GetChunkBorders(mChunkX, mChunkY);
+	if (borders.loadedMask & ~mNeighborsLoaded) Remesh();
+
+	for (int d = MeshData::LEFT; d <= MeshData::BACK; d++)
+	{
+		AChunk* neighbor = FindChunk(mChunkX + NEIGHBOR_OFFSETS[d - MeshData::LEFT][0], mChunkY + NEIGHBOR_OFFSETS[d - MeshData::LEFT][1]);
+		int opposite = (d ^ 1) - MeshData::LEFT;
+		if (neighbor && !(neighbor->mNeighborsLoaded & (1 << opposite))) neighbor->Remesh();
 	}
 }
 
-void AChunk::PlayerMovedToAnotherChunk(int newChunkX, int newChunkY, TQueue<TArray<MeshData*>> &chunkLoaderQueue, 
-	TFunction <BlockType(int32 i, int32 j, int32 k)> PopulateBlock,
-	int32 ChunkRenderDistance)
+int32 AChunk::GetLodForDistance(int32 distance)
 {
-	// Go through all the chunks in the ChunkMap, remove the extra chunks
-	// TODO: put this back to unload chunks
-	//TArray<int32> keys;
-	//AChunk::ChunkMap.GetKeys(keys);
+	int32 lod = 0;
+	while (lod < FChunkLod::MaxLod && lod < LodDistances.Num() && distance > LodDistances[lod]) lod++;
 
-	//for (FVector2D k : keys)
-	//{
-	//	if (abs(k.X - chunkX) > CHUNK_RENDER_DISTANCE || abs(k.Y - chunkY) > CHUNK_RENDER_DISTANCE)
-	//		AChunk::ChunkMap.Remove(k);
-	//}
-	//AChunk::ChunkMap.Compact();
+	return lod;
+}
 
-	TFunction<void(int32 i, int32 j, TFunction <BlockType(int32 i, int32 j, int32 k)>)> LoadChunk = [&chunkLoaderQueue](int32 i, int32 j,
-		TFunction <BlockType(int32 i, int32 j, int32 k)> PopulateBlock)
-	{
-		int hash = GetHashFromChunkPosition(i, j);
-		if (ChunkMap.Contains(hash) || chunkResults.Contains(hash)) return;
+void AChunk::UpdateLod()
+{
+	int32 lod = GetLodForDistance(FMath::Max(FMath::Abs(mChunkX - PlayerChunkX), FMath::Abs(mChunkY - PlayerChunkY)));
+	if (lod == mLod) return;
 
-		// Create the chunk
-		TFunction<void()> ChunkCallback = [i, j, renderer = &chunkLoaderQueue]()
-		{
-			TFuture<TArray<MeshData*>>** result = chunkResults.Find(GetHashFromChunkPosition(i, j));
-			chunkResults.Remove(GetHashFromChunkPosition(i, j));
+	mLod = lod;
+	for (int32 section = 0; section < mSectionCount; section++)
+		MarkSectionDirty(section);
+}
 
-			if (result)
-			{
-				renderer->Enqueue((*result)->Get());
-			}
-		};
-		TFunction<TArray<MeshData*>()> ChunkTask = [i, j, PopulateBlock]()
-		{
-			return GetMeshDataForChunk(i, j, PopulateBlock);
-		};
+FVector AChunk::GetChunkOrigin(int32 ChunkX, int32 ChunkY)
+{
+	return FVector(ChunkX * 1600, ChunkY * 1600, -1000);
+}
 
-		TFuture<TArray<MeshData*>>* t = new TFuture<TArray<MeshData*>>(Async(EAsyncExecution::ThreadPool, ChunkTask, ChunkCallback));
-		chunkResults.Add(GetHashFromChunkPosition(i, j), t);
-	};
+void AChunk::PlayerMovedToAnotherChunk(int newChunkX, int newChunkY, FVector2D viewDirection,
+	FChunkLoadScheduler& scheduler, int32 ChunkRenderDistance, int32 ChunkUnloadMargin)
+{
+	// Go through all the chunks in the ChunkRegistry, release the ones past the render distance plus
+	// the margin, so walking back and forth over a chunk border doesn't reload the same ring
+	TArray<AChunk*> chunks;
+	ChunkRegistry.GetChunks(chunks);
+	for (AChunk* chunk : chunks)
+	{
+		if (abs(chunk->mChunkX - newChunkX) > ChunkRenderDistance + ChunkUnloadMargin ||
+			abs(chunk->mChunkY - newChunkY) > ChunkRenderDistance + ChunkUnloadMargin)
+			chunk->Release();
+	}
 
-	// TODO: Use a heap to give priority to the chunks closest to the player
+	// The chunks that crossed a LOD distance are remeshed at the new one
+	PlayerChunkX = newChunkX; PlayerChunkY = newChunkY;
+	ChunkRegistry.GetChunks(chunks);
+	for (AChunk* chunk : chunks)
+		chunk->UpdateLod();
 
-	// Go through all the chunks that need to be rendered, figure out which need to be added to the chunkmap
+	// Re-prioritize what's pending around the new position and cancel what's out of range
+	scheduler.SetCenter(newChunkX, newChunkY, viewDirection, ChunkRenderDistance);
+
+	// Go through all the chunks that need to be rendered, the ones with any state are loaded or on their way,
+	// including the ones waiting in the upload queue
 	for (int i = newChunkX - ChunkRenderDistance; i <= newChunkX + ChunkRenderDistance; i++)
 	{
 		for (int j = newChunkY - ChunkRenderDistance; j <= newChunkY + ChunkRenderDistance; j++)
 		{
-			if (i != 0 || j != 0)
-				LoadChunk(i, j, PopulateBlock);
+			if (ChunkRegistry.GetState(i, j) == EChunkState::None)
+				scheduler.Request(i, j);
 		}
 	}
 }
 
+// Takes the chunk out of the ChunkRegistry and parks the actor in the pool, keeping its mesh sections so
+// the next chunk that reuses it only replaces them. Neighbors keep the faces they culled against
+// this chunk, they are on the far side of the loaded area and can't be seen from inside it
+void AChunk::Release()
+{
+	// Lookups stop finding it while its blocks go away
+	ChunkRegistry.SetState(mChunkX, mChunkY, EChunkState::Unloading);
+	VisibilityGraph.RemoveChunk(mChunkX, mChunkY);
+
+	// The blocks aren't needed anymore, so they're moved to the save instead of copied
+	if (mModified && RegionStore) RegionStore->SaveAsync(mChunkX, mChunkY, MoveTemp(mBlocks));
+	mModified = false;
+
+	mBlocks.Empty();
+	mLight.Empty();
+	mNeighborsLoaded = 0;
+
+	// Remeshes still in flight are dropped when they come back
+	mDirtySections = 0; mUrgentSections = 0;
+	for (uint32& version : mSectionVersions) version++;
+	ClearCollision();
+
+	ChunkRegistry.Remove(mChunkX, mChunkY);
+
+	if (ChunkPool.Num() >= MaxPooledChunks)
+	{
+		Destroy();
+		return;
+	}
+
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+	ChunkPool.Add(this);
+}
+
+void AChunk::SaveModifiedChunks()
+{
+	if (!RegionStore) return;
+
+	TArray<AChunk*> chunks;
+	ChunkRegistry.GetChunks(chunks);
+	for (AChunk* chunk : chunks)
+	{
+		if (!chunk->mModified) continue;
+
+		RegionStore->SaveAsync(chunk->mChunkX, chunk->mChunkY, FChunkBlockStorage(chunk->mBlocks));
+		chunk->mModified = false;
+	}
+}
+
+AChunk* AChunk::AcquireChunk(UWorld* World, const FTransform& transform)
+{
+	while (ChunkPool.Num() > 0)
+	{
+		AChunk* chunk = ChunkPool.Pop(EAllowShrinking::No).Get();
+
+		// Pooled actors can be gone with the world they were spawned in
+		if (!IsValid(chunk) || chunk->GetWorld() != World) continue;
+
+		chunk->SetActorTransform(transform);
+		chunk->SetActorHiddenInGame(false);
+		chunk->SetActorEnableCollision(true);
+		return chunk;
+	}
+
+	return World->SpawnActor<AChunk>(AChunk::StaticClass(), transform);
+}
+
 //TODO: Is this used??
 void FChunkCreateTask::DoWork() {
 	AChunk::CreateChunk(ChunkX, ChunkY, World);
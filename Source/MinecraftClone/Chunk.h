@@ -7,8 +7,21 @@
 #include "ProceduralMeshComponent.h"
 #include "Engine/Engine.h"
 #include "Containers/Map.h"
+#include "ChunkBlockStorage.h"
+#include "ChunkLightStorage.h"
+#include "BlockRegistry.h"
+#include "MeshDataPool.h"
+#include "SectionVisibility.h"
+#include "ChunkRegistry.h"
 #include "Chunk.generated.h"
 
+class FChunkLoadScheduler;
+class FChunkRemeshQueue;
+class FChunkUploadQueue;
+class FChunkRegionStore;
+class IChunkGenerator;
+class FSectionFaceMasks;
+
 UENUM(BlueprintType)
 enum class BlockType : uint8
 {
@@ -20,20 +33,93 @@ enum class BlockType : uint8
 	LEAVES UMETA(DisplayName = "LEAVES")
 };
 
-class MeshData
+// PER_FACE emits one quad per visible face with atlas UVs, GREEDY merges coplanar faces
+// of the same block and tile into bigger quads, see AChunk::AddGreedyFaces
+UENUM(BlueprintType)
+enum class MeshingMode : uint8
+{
+	PER_FACE UMETA(DisplayName = "PER_FACE"),
+	GREEDY UMETA(DisplayName = "GREEDY")
+};
+
+// A quad of a section mesh in 8 bytes instead of ~450 for its 4 vertices and 6 indices. Normals,
+// tangents and UVs only depend on the direction and tile, so the vertex arrays of the procedural mesh
+// are rebuilt from these on the game thread right before uploading, see AChunk::ExpandMeshData.
+// Position: k, j and the i inside the section of the first block, then extent - 1 along k, j and i,
+// 5 bits each. Attributes: MeshData::Direction in 3 bits, atlas tile in 8 bits and the light of the
+// 4 corners (MeshData::VERTICES order) in 4 bits each.
+struct FPackedQuad
+{
+	static const uint32 MaxLight = 15;
+
+	uint32 Position = 0;
+	uint32 Attributes = 0;
+
+	static FPackedQuad Pack(uint8 direction, int32 tile, int32 localI, int32 j, int32 k,
+		int32 extentI, int32 extentJ, int32 extentK, uint16 cornerLights = 0xFFFF)
+	{
+		FPackedQuad quad;
+		quad.Position = uint32(k) | (uint32(j) << 5) | (uint32(localI) << 10) |
+			(uint32(extentK - 1) << 15) | (uint32(extentJ - 1) << 20) | (uint32(extentI - 1) << 25);
+		quad.Attributes = uint32(direction) | (uint32(tile & 0xFF) << 3) | (uint32(cornerLights) << 11);
+		return quad;
+	}
+
+	int32 GetK() const { return Position & 31; }
+	int32 GetJ() const { return (Position >> 5) & 31; }
+	int32 GetLocalI() const { return (Position >> 10) & 31; }
+	int32 GetExtentK() const { return ((Position >> 15) & 31) + 1; }
+	int32 GetExtentJ() const { return ((Position >> 20) & 31) + 1; }
+	int32 GetExtentI() const { return ((Position >> 25) & 31) + 1; }
+
+	uint8 GetDirection() const { return Attributes & 7; }
+	int32 GetTile() const { return (Attributes >> 3) & 0xFF; }
+	uint32 GetCornerLight(int32 corner) const { return (Attributes >> (11 + corner * 4)) & MaxLight; }
+
+	bool operator==(const FPackedQuad& other) const
+	{
+		return Position == other.Position && Attributes == other.Attributes;
+	}
+};
+
+// The arrays CreateMeshSection_LinearColor takes, filled from the packed quads of a MeshData
+struct FChunkMeshBuffers
 {
-public:
 	TArray<FVector> vertices;
 	TArray<int32> Triangles;
 	TArray<FVector> normals;
 	TArray<FVector2D> UV0;
 	TArray<FProcMeshTangent> tangents;
 	TArray<FLinearColor> vertexColors;
-	TArray<BlockType> blocks;
+
+	// Keeps the allocations around for the next section
+	void Reset()
+	{
+		vertices.Reset(); Triangles.Reset(); normals.Reset();
+		UV0.Reset(); tangents.Reset(); vertexColors.Reset();
+	}
+};
+
+class MeshData
+{
+public:
+	TArray<FPackedQuad> quads;
+	int32 sectionID = 0;
 	int32 sectionSide;
 	int32 sectionCount;
 	int32 chunkI;
 	int32 chunkJ;
+	MeshingMode meshingMode = MeshingMode::PER_FACE;
+	double meshingSeconds = 0.0;
+	// Bit (direction - LEFT) is set for the horizontal neighbors that were loaded when meshing
+	uint8 neighborsLoaded = 0;
+	// Blocks per cell along each axis, sections meshed from FChunkLod volumes have quads in cells
+	int32 lodScale = 1;
+	// Faces of the section that see each other, see FSectionConnectivity
+	uint16 connectivity = FSectionConnectivity::All;
+
+	int32 GetVertexCount() const { return quads.Num() * 4; }
+	int32 GetTriangleCount() const { return quads.Num() * 2; }
 
 	static enum Direction
 	{
@@ -46,72 +132,142 @@ public:
 		SIZE = 6
 	};
 
-	const FString DirectionImage[Direction::SIZE][8] =
-	{
-		"UP", "DOWN", "LEFT", "RIGHT", "FORWARD", "BACK"
-	};
+	static const TCHAR* const DirectionImage[Direction::SIZE];
+
+	// Tiles per row and column of the atlas, the tile of every face is in FBlockRegistry
+	static const int32 ATLAS_SIZE = 4;
+
+	// The tables are shared by every MeshData, so a new one only has its quads to set up
+	static const FVector NORMALS[Direction::SIZE];
+
+	static const FProcMeshTangent TANGENTS[Direction::SIZE];
+
+	static const FVector VERTICES[Direction::SIZE][4];
+
+	static const FVector2D UVS[Direction::SIZE][4];
+
+	// Which vertex axis (0 = X, 1 = Y, 2 = Z) the U and V coordinates of UVS_Inverted follow,
+	// used to repeat the tile once per block on greedy quads
+	static const int32 UV_AXES[Direction::SIZE][2];
 
+	static const FVector2D UVS_Inverted[Direction::SIZE][4];
 
-	const int32 ATLAS_SIZE = 4;
-	// Top1, Side1, Bottom1, Top2, Side2, Bottom2, Top3, Side3, Bottom3, ...
-	// Needs to be BLOCKTYPE::SIZE * 3
-	const int32 BlockTypeTextureIndex[6][3] =
+	// Back to a new MeshData, keeping the allocation of the quads, see FMeshDataPool
+	void Reset()
 	{
-		{-1, -1, -1},// AIR
-		{0,  3,  2},// GRASS
-		{2,  2,  2},// DIRT
-		{1,  1,  1},// STONE
-		{5,  4,  5},// WOOD
-		{6,  6,  6}// LEAVES
-	};
+		TArray<FPackedQuad> keptQuads = MoveTemp(quads);
+		*this = MeshData();
+		quads = MoveTemp(keptQuads);
+		quads.Reset();
+	}
+};
 
-	const FVector NORMALS[Direction::SIZE] =
-	{ FVector(0,0,1), // up
-	  FVector(0,0,-1), // down
-	  FVector(-1,0,0), // left
-	  FVector(1,0,0), // right
-	  FVector(0,-1,0), // forward
-	  FVector(0,1,0) // back 
-	};
+// Blocks of the four horizontal neighbor chunks touching this one, one slice per wall,
+// so faces on the chunk walls are only emitted when the neighbor block is air or not loaded
+class FChunkBorders
+{
+public:
+	// Indexed by direction - MeshData::LEFT, each slice is height * sectionSide blocks
+	TArray<BlockType> slices[4];
+	uint8 loadedMask = 0;
 
-	const FProcMeshTangent TANGENTS[Direction::SIZE] =
-	{ FProcMeshTangent(1, 0, 0), // up
-	  FProcMeshTangent(1, 0, 0), // down
-	  FProcMeshTangent(0, 0, 1), // left
-	  FProcMeshTangent(0, 0, 1), // right
-	  FProcMeshTangent(0, 0, 1), // forward
-	  FProcMeshTangent(0, 0, 1) // back
-	};
+	// Same layout with the FChunkLightStorage values of the wall, empty if the neighbor has no light
+	TArray<uint8> lightSlices[4];
 
-	const FVector VERTICES[Direction::SIZE][4] =
+	// Bit s is set if the wall slice of section s is all opaque blocks
+	uint32 opaqueSections[4] = { 0, 0, 0, 0 };
+
+	bool IsLoaded(MeshData::Direction direction) const
 	{
-		{ FVector(1, 0, 1), FVector(0, 0, 1), FVector(1, 1, 1), FVector(0, 1, 1) },
-		{ FVector(0, 0, 0), FVector(1, 0, 0), FVector(0, 1, 0), FVector(1, 1, 0) },
-		{ FVector(0, 0, 0), FVector(0, 1, 0), FVector(0, 0, 1), FVector(0, 1, 1) },
-		{ FVector(1, 1, 0), FVector(1, 0, 0), FVector(1, 1, 1), FVector(1, 0, 1) },
-		{ FVector(0, 0, 0), FVector(0, 0, 1), FVector(1, 0, 0), FVector(1, 0, 1) },
-		{ FVector(0, 1, 0), FVector(1, 1, 0), FVector(0, 1, 1), FVector(1, 1, 1) }
-	};
+		return (loadedMask & (1 << (direction - MeshData::LEFT))) != 0;
+	}
 
-	const FVector2D UVS[Direction::SIZE][4] =
+	// along is j for the LEFT/RIGHT walls and k for the FORWARD/BACK walls
+	BlockType Get(MeshData::Direction direction, int i, int along, int sectionSide) const
 	{
-		{ FVector2D(0.9, 0.1), FVector2D(0.1, 0.1), FVector2D(0.9, 0.9), FVector2D(0.1, 0.9) }, // up
-		{ FVector2D(0.01, 0.01), FVector2D(0.99, 0.01), FVector2D(0.01, 0.99), FVector2D(0.99, 0.99) }, // down
-		{ FVector2D(0.01, 0.01), FVector2D(0.99, 0.01), FVector2D(0.01, 0.99), FVector2D(0.99, 0.99) }, // left
-		{ FVector2D(0.99, 0.01), FVector2D(0.01, 0.01), FVector2D(0.99, 0.99), FVector2D(0.01, 0.99) }, // right
-		{ FVector2D(0.01, 0.01), FVector2D(0.01, 0.99), FVector2D(0.99, 0.01), FVector2D(0.99, 0.99) }, // forward
-		{ FVector2D(0.01, 0.01), FVector2D(0.99, 0.01), FVector2D(0.01, 0.99), FVector2D(0.99, 0.99) }  // back
-	};
+		return slices[direction - MeshData::LEFT][i * sectionSide + along];
+	}
 
-	const FVector2D UVS_Inverted[Direction::SIZE][4] =
+	uint8 GetLight(MeshData::Direction direction, int i, int along, int sectionSide) const
 	{
-		{ FVector2D(0, 1), FVector2D(1, 1), FVector2D(0, 0), FVector2D(1, 0) }, // up
-		{ FVector2D(1, 1), FVector2D(0, 1), FVector2D(1, 0), FVector2D(0, 0) }, // down
-		{ FVector2D(1, 1), FVector2D(0, 1), FVector2D(1, 0), FVector2D(0, 0) }, // left
-		{ FVector2D(0, 1), FVector2D(1, 1), FVector2D(0, 0), FVector2D(1, 0) }, // right
-		{ FVector2D(1, 1), FVector2D(1, 0), FVector2D(0, 1), FVector2D(0, 0) }, // forward
-		{ FVector2D(1, 1), FVector2D(0, 1), FVector2D(1, 0), FVector2D(0, 0) }  // back
-	};
+		return lightSlices[direction - MeshData::LEFT][i * sectionSide + along];
+	}
+
+	// Sets the slice of the direction from the wall of the neighbor chunk that faces this one
+	void SetNeighbor(MeshData::Direction direction, const FChunkBlockStorage& neighbor,
+		const FChunkLightStorage* neighborLight = nullptr);
+
+	// Same, from the walls of the neighbor already taken with GetWalls
+	void SetNeighbor(MeshData::Direction direction, const FChunkBorders& neighborWalls);
+
+	// The chunk's own walls, the slice of a direction is the wall on that side of the chunk
+	static FChunkBorders GetWalls(const FChunkBlockStorage& blocks, const FChunkLightStorage* light = nullptr);
+
+private:
+	static void GetWall(const FChunkBlockStorage& blocks, const FChunkLightStorage* light, int32 wall,
+		TArray<BlockType>& slice, TArray<uint8>& lightSlice, uint32& opaqueSections);
+};
+
+// Read only view of the blocks of a chunk, its light and the walls of its neighbors. It doesn't own or
+// copy any of them, so it's cheap to pass down the meshing functions, but they have to outlive it.
+class FChunkVolumeView
+{
+public:
+	FChunkVolumeView(const FChunkBlockStorage& blocks, const FChunkBorders* borders = nullptr,
+		const FChunkLightStorage* light = nullptr) :
+		mBlocks(&blocks), mBorders(borders), mLight(light) {}
+
+	FORCEINLINE BlockType Get(int i, int j, int k) const { return mBlocks->Get(i, j, k); }
+
+	const FChunkBlockStorage& GetBlocks() const { return *mBlocks; }
+
+	// Null when meshing without neighbors, every wall face is emitted then
+	const FChunkBorders* GetBorders() const { return mBorders; }
+
+	int32 GetSectionSide() const { return mBlocks->GetSectionSide(); }
+	int32 GetSectionCount() const { return mBlocks->GetSectionCount(); }
+
+	// Null when meshing without light, every corner is fully lit then
+	const FChunkLightStorage* GetLight() const { return mLight; }
+
+	// Brightness of the open block at i, j, k, which can be one block into the neighbor walls. False for
+	// opaque blocks and for blocks whose light isn't known, the sky above the world is fully lit
+	bool GetLightSample(int i, int j, int k, uint8& light) const;
+
+private:
+	const FChunkBlockStorage* mBlocks;
+	const FChunkBorders* mBorders;
+	const FChunkLightStorage* mLight;
+};
+
+// A chunk on its way from the worker that generated and meshed it to AChunk::CreateChunk, which
+// moves the blocks into the actor so they're only allocated once
+class FChunkBuildResult
+{
+public:
+	int32 chunkX = 0;
+	int32 chunkY = 0;
+	FChunkBlockStorage blocks;
+	// Moved into the actor along with the blocks, see FChunkLighting
+	FChunkLightStorage light;
+	// One per section, owned by the result and given back to the FMeshDataPool with it
+	TArray<MeshData*> sections;
+	MeshingMode meshingMode = MeshingMode::PER_FACE;
+	// Neighbors the sections were meshed against, see MeshData::neighborsLoaded
+	uint8 neighborsLoaded = 0;
+	// The sections are meshed at this LOD, the blocks are always the full ones
+	int32 lod = 0;
+	// FPlatformTime::Seconds() when the chunk was requested, 0 if it wasn't, see FChunkStats::AddTimeToVisible
+	double requestSeconds = 0.0;
+
+	FChunkBuildResult() {}
+	FChunkBuildResult(const FChunkBuildResult&) = delete;
+	FChunkBuildResult& operator=(const FChunkBuildResult&) = delete;
+
+	~FChunkBuildResult()
+	{
+		for (MeshData* d : sections) FMeshDataPool::Release(d);
+	}
 };
 
 UCLASS(Blueprintable)
@@ -127,35 +283,135 @@ public:
 
 	void BeginDestroy();
 
-	static TArray<BlockType> GenerateChunkData(int chunkI, int chunkJ, int sectionSideWidth, int numberOfSections,
-		int& sideWidth, int& sectionCount,
-		TFunction <BlockType(int32 i, int32 j, int32 k)> PopulateBlock);
+	static FChunkBlockStorage GenerateChunkData(int chunkI, int chunkJ, int sectionSideWidth, int numberOfSections,
+		int& sideWidth, int& sectionCount, const IChunkGenerator& generator);
+
+	UFUNCTION(BlueprintCallable, Category = "VoxelChunk")
+	void CreateVoxelChunk(const TArray<BlockType>& blocks, int sectionSide, int sectionCount);
 
+	// GREEDY falls back to PER_FACE with an error when the greedy material is missing
 	UFUNCTION(BlueprintCallable, Category = "VoxelChunk")
-	void CreateVoxelChunk(TArray<BlockType> blocks, int sectionSide, int sectionCount);
+	void SetMeshingMode(MeshingMode meshingMode);
+
+	// GREEDY can't render without FChunkGreedyMaterial, which only the editor builds. Game thread
+	static bool HasGreedyMaterial();
 
 	void AddVoxel(FVector insidePoint, BlockType blockTypeToAdd);
 
 	void RemoveVoxel(FVector insidePoint);
 
-	static void PlayerMovedToAnotherChunk(int newChunkX, int newChunkY, TQueue<TArray<MeshData*>>& chunkLoaderQueue,
-		TFunction <BlockType(int32 i, int32 j, int32 k)> PopulateBlock,
-		int32 ChunkRenderDistance);
+	// Blocks and their light
+	SIZE_T GetBlockMemory() const { return mBlocks.GetAllocatedSize() + mLight.GetAllocatedSize(); }
 
-	static TMap<int32, AChunk*> ChunkMap;
-	const static int BlockSize = 100;
+	// AIR outside of the chunk
+	FORCEINLINE BlockType GetVoxel(int i, int j, int k) const
+	{
+		if (i < 0 || i >= mSectionCount * mSectionSide || j < 0 || j >= mSectionSide || k < 0 || k >= mSectionSide) return BlockType::AIR;
+		return mBlocks.Get(i, j, k);
+	}
 
-	static TMap <int32, TFuture<TArray<MeshData*>>*> chunkResults;
+	static void PlayerMovedToAnotherChunk(int newChunkX, int newChunkY, FVector2D viewDirection,
+		FChunkLoadScheduler& scheduler, int32 ChunkRenderDistance, int32 ChunkUnloadMargin = 2);
+
+	// Removes the chunk from the ChunkRegistry and returns the actor to the ChunkPool, edited chunks are
+	// saved to the RegionStore first
+	void Release();
+
+	// Saves every edited chunk of the ChunkRegistry to the RegionStore, without releasing them
+	static void SaveModifiedChunks();
+
+	// Where edited chunks are saved, chunks aren't saved if it's null
+	static TSharedPtr<FChunkRegionStore, ESPMode::ThreadSafe> RegionStore;
+
+	// Queues the section for FChunkRemeshQueue, urgent for block edits so they show up right away
+	void MarkSectionDirty(int32 section, bool urgent = false);
+
+	// Chunks with dirty sections, in the order they were first marked
+	static TArray<TWeakObjectPtr<AChunk>> DirtyChunks;
+
+	// Loaded and requested chunks with their lifecycle state, safe to look up from any thread
+	static FChunkRegistry ChunkRegistry;
+
+	// Released chunk actors waiting to be reused by CreateChunk
+	static TArray<TWeakObjectPtr<AChunk>> ChunkPool;
+	const static int MaxPooledChunks = 64;
+	const static int BlockSize = 100;
 
 	static MeshData* GetMeshData(int32 chunkI, int32 chunkJ, 
-		int32 sectionID, int32 sectionCount, TArray<BlockType> blocks, int32 sectionSide);
+		int32 sectionID, const FChunkVolumeView& volume,
+		MeshingMode meshingMode = MeshingMode::PER_FACE);
 	static TArray<MeshData*> GetMeshDataForChunk(int32 chunkI, int32 chunkJ, 
-		int32 sectionCount, TArray<BlockType> blocks, int32 sectionSide);
-	static TArray<MeshData*> GetMeshDataForChunk(int32 ChunkX, int32 ChunkY,
-		TFunction <BlockType(int32 i, int32 j, int32 k)> PopulateBlock);
+		const FChunkVolumeView& volume, MeshingMode meshingMode = MeshingMode::PER_FACE, int32 lod = 0);
+
+	// GetMeshData for a volume downsampled with FChunkLod, adds the skirts along the chunk walls
+	static MeshData* GetLodMeshData(int32 chunkI, int32 chunkJ, int32 sectionID, const FChunkVolumeView& volume,
+		MeshingMode meshingMode, int32 lod);
+
+	// Generates and meshes the chunk, the result owns the blocks and mesh data until CreateChunk
+	static TUniquePtr<FChunkBuildResult> BuildChunk(int32 ChunkX, int32 ChunkY, const IChunkGenerator& generator,
+		MeshingMode meshingMode = MeshingMode::PER_FACE, const FChunkBorders* borders = nullptr, int32 lod = 0);
+
+	// Same with blocks that were already generated, they are moved into the result along with their light,
+	// which is computed here if it's empty
+	static TUniquePtr<FChunkBuildResult> BuildChunk(int32 ChunkX, int32 ChunkY, FChunkBlockStorage&& blocks,
+		MeshingMode meshingMode = MeshingMode::PER_FACE, const FChunkBorders* borders = nullptr, int32 lod = 0,
+		FChunkLightStorage&& light = FChunkLightStorage());
+
+	// Chunks further than LodDistances[n] chunks from the player (on either axis) are meshed at LOD n + 1,
+	// at most FChunkLod::MaxLod. Empty meshes everything at full resolution
+	static TArray<int32> LodDistances;
+
+	static int32 GetLodForDistance(int32 distance);
+
+	// Connectivity of the sections uploaded so far, of the chunks in the ChunkRegistry
+	static FSectionVisibilityGraph VisibilityGraph;
+
+	// Hides the sections the camera can't see through the sections around it, only does the search
+	// again when the camera moves to another section or a section changes
+	static void UpdateSectionVisibility(const FVector& cameraLocation, int32 maxDistance);
+
+	// Sections shown after the last UpdateSectionVisibility, and sections of the chunks in the ChunkRegistry
+	static int32 VisibleSectionCount;
+	static int32 LoadedSectionCount;
+
+	// Chunk the LOD distances are measured from, set by PlayerMovedToAnotherChunk
+	static int32 PlayerChunkX;
+	static int32 PlayerChunkY;
+
+	// Switches the chunk to the LOD for its distance to the player, remeshing it if it changes
+	void UpdateLod();
+
+	// True if the section can't produce any face: it's all AIR, or it's all solid and every block
+	// around it is solid too. Only looks at the section summaries, the blocks are not scanned
+	static bool IsSectionHidden(const FChunkVolumeView& volume, int32 section);
+
+	// Copies the wall slices of the loaded neighbors of the given chunk, game thread only
+	static FChunkBorders GetChunkBorders(int32 ChunkX, int32 ChunkY);
+
+	static AChunk* FindChunk(int32 ChunkX, int32 ChunkY);
+
+	// Meshes the same chunk with every MeshingMode and logs vertices, triangles and time per section
+	static void LogMeshingComparison(int32 ChunkX, int32 ChunkY, const IChunkGenerator& generator);
+
+	// Meshes every section of the chunk iterations times with the bitmask and the per block face checks
+	// on this thread, checks both give the same mesh and logs the sections per second of each
+	static void LogMesherBenchmark(int32 ChunkX, int32 ChunkY, const IChunkGenerator& generator, int32 iterations);
 
 	void static CreateChunk(int32 ChunkX, int32 ChunkY, UWorld* World);
-	void static CreateChunk(int32 ChunkX, int32 ChunkY, UWorld* World, TArray<MeshData*> chunkData);
+	// Places the chunk and uploads all its sections right away
+	void static CreateChunk(UWorld* World, TUniquePtr<FChunkBuildResult> chunk);
+
+	// Takes an actor for the chunk, moves the blocks into it and adds it to the ChunkRegistry, but doesn't
+	// upload any section. Returns null if the chunk already has an actor. placedVersions gets mSectionVersions
+	// from before the light stitching, so the sections it dirtied look newer than the built ones
+	static AChunk* PlaceChunk(UWorld* World, FChunkBuildResult& chunk, uint32* placedVersions = nullptr);
+
+	// Once the sections are uploaded, remeshes this chunk and its neighbors if they were meshed
+	// without each other
+	void RemeshStaleNeighbors();
+
+	// World location of the chunk actor
+	static FVector GetChunkOrigin(int32 ChunkX, int32 ChunkY);
 
 protected:
 	// Called when the game starts or when spawned
@@ -175,32 +431,122 @@ private:
 	UPROPERTY(VisibleAnywhere)
 	int mSectionCount = 10;
 
+	// Palette compressed, see FChunkBlockStorage
+	FChunkBlockStorage mBlocks;
+
+	// Sky and block light of every block, kept up to date by FChunkLighting
+	FChunkLightStorage mLight;
+
 	UPROPERTY(VisibleAnywhere)
-	TArray<BlockType> mBlocks;
+	int32 mChunkX = 0;
+
+	UPROPERTY(VisibleAnywhere)
+	int32 mChunkY = 0;
+
+	// Neighbors that were loaded the last time this chunk was meshed, see MeshData::neighborsLoaded
+	uint8 mNeighborsLoaded = 0;
+
+	// LOD the sections are meshed at, see FChunkLod
+	int32 mLod = 0;
+
+	// Bit s is clear if section s is hidden by UpdateSectionVisibility
+	uint32 mVisibleSections = ~0u;
+
+	void SetVisibleSections(uint32 visibleSections);
+
+	// Blocks were edited since the chunk was placed or saved
+	bool mModified = false;
+
+	// Collision boxes, given and taken by FChunkCollisionQueue
+	bool mHasCollision = false;
+	bool mCollisionDirty = false;
+	// Bumped when the collision is cleared, boxes computed before that are thrown away
+	uint32 mCollisionVersion = 0;
+
+	void SetCollisionBoxes(const TArray<FBox>& boxes);
+	void ClearCollision();
+
+	UPROPERTY(EditAnywhere, Category = "VoxelChunk")
+	MeshingMode mMeshingMode = MeshingMode::PER_FACE;
+
+	// Bit s is set for the sections waiting for FChunkRemeshQueue, sections are at most 32
+	uint32 mDirtySections = 0;
+	uint32 mUrgentSections = 0;
+
+	// Bumped every time a section is marked dirty and when the chunk is released, remeshed
+	// sections are only uploaded if they were meshed from the latest version
+	uint32 mSectionVersions[32] = {};
+
+	friend class FChunkRemeshQueue;
+	friend class FChunkUploadQueue;
+	friend class FChunkCollisionQueue;
+	friend class FChunkLighting;
+
+	// GREEDY chunks use FChunkGreedyMaterial instead, which repeats the atlas cell
+	UPROPERTY()
+	UMaterial* mFaceMaterial;
 
 	void PostActorCreated();
 
 	void PostLoad();
 
+	// True when the face is exposed, that is the neighbor block in that direction isn't opaque
 	static bool CheckIfNeighboorIsAir(MeshData::Direction direction,
-		TArray<BlockType>& blocks, int i, int j, int k, 
-		int sectionCount, int sectionSide, MeshData& data);
+		const FChunkVolumeView& volume, int i, int j, int k, MeshData& data);
+
+	void SetVoxel(int i, int j, int k, BlockType blockType);
+
+	void UploadSection(int32 section, MeshData* d);
+
+	// Takes a chunk out of the ChunkPool, or spawns one if the pool is empty
+	static AChunk* AcquireChunk(UWorld* World, const FTransform& transform);
+
+	// Marks every section dirty to rebuild them against the neighbors currently in the ChunkRegistry
+	void Remesh();
+
+	FChunkBorders GetBorders() const;
 
 	static void AddVoxelFace(MeshData::Direction direction, 
 		BlockType currentBlockType,
 		MeshData* data,
-		int i, int j, int k);
+		int i, int j, int k,
+		uint16 cornerLights = 0xFFFF);
+
+	// Light of the 4 corners of the face for FPackedQuad, each one the average of the open blocks
+	// in front of the face that touch the corner, like Minecraft's smooth lighting
+	static uint16 GetCornerLights(const FChunkVolumeView& volume, MeshData::Direction direction,
+		int i, int j, int k, const MeshData& data);
+
+	// Adds the faces set in the masks, in the same order as the per block loop of GetMeshData
+	static void AddVisibleFaces(const FChunkVolumeView& volume, const FSectionFaceMasks& masks, int32 sectionID, MeshData* data);
+
+	// Without masks the visibility of every face is checked with CheckIfNeighboorIsAir
+	static void AddGreedyFaces(const FChunkVolumeView& volume, int32 sectionID,
+		MeshData* data, const FSectionFaceMasks* masks = nullptr);
+
+	static void AddGreedyFace(MeshData::Direction direction,
+		BlockType currentBlockType,
+		MeshData* data,
+		int i, int j, int k,
+		int extentI, int extentJ, int extentK,
+		uint16 cornerLights = 0xFFFF);
+
+	static int32 GetTextureIndex(MeshData::Direction direction, BlockType blockType, const MeshData& data);
+
+	// Cells of skirt hanging below the surface along the chunk walls of LOD meshes
+	static const int32 SKIRT_CELLS = 2;
+
+	// Wall faces of the top SKIRT_CELLS solid cells of every column on the chunk walls, where the
+	// neighbor culled them, to cover the gaps against neighbors meshed at another LOD
+	static void AddSkirts(const FChunkVolumeView& volume, int32 sectionID, MeshData* data);
+
+	// Unpacks the quads of the section into the vertex arrays of the procedural mesh, out is reset first
+	static void ExpandMeshData(const MeshData& data, FChunkMeshBuffers& out);
 
 	static int GetPositionInTArray(int i, int j, int k, int sectionSide);
 
 	static void GetIJKFromPositionInTArray(int pos, int sectionSide, int &i, int &j, int &k);
 
-	static int GetHashFromChunkPosition(int ChunkX, int ChunkY)
-	{
-		uint32 half16bit = 1 << 15;
-		return uint32(uint32(ChunkX + half16bit) << 16) + uint16(ChunkY + half16bit);
-	}
-
 	void CreateTriangle();
 };
 
@@ -0,0 +1,348 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkBenchmarkCommandlet.h"
+#include "Chunk.h"
+#include "TerrainGenerator.h"
+#include "Async/ParallelFor.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonSerializer.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include <atomic>
+
+// Counts the allocations and the bytes alive while a stage runs, wraps GMalloc for the whole commandlet.
+// Allocators the engine calls without going through GMalloc can't be wrapped, there's nothing to count then
+class FBenchmarkMalloc final : public FMalloc
+{
+public:
+	explicit FBenchmarkMalloc(FMalloc* inner) : mInner(inner) {}
+
+	// Counts from zero, peak bytes are relative to the bytes alive now
+	void Reset()
+	{
+		mAllocations = 0;
+		mBaseBytes = mLiveBytes.load();
+		mPeakBytes = mBaseBytes.load();
+	}
+
+	int64 GetAllocations() const { return mAllocations; }
+	int64 GetPeakBytes() const { return mPeakBytes - mBaseBytes; }
+
+	virtual void* Malloc(SIZE_T count, uint32 alignment) override
+	{
+		void* result = mInner->Malloc(count, alignment);
+		mAllocations++;
+		AddBytes(GetSize(result));
+		return result;
+	}
+
+	virtual void* Realloc(void* original, SIZE_T count, uint32 alignment) override
+	{
+		int64 oldSize = GetSize(original);
+		void* result = mInner->Realloc(original, count, alignment);
+		mAllocations++;
+		AddBytes(GetSize(result) - oldSize);
+		return result;
+	}
+
+	virtual void Free(void* original) override
+	{
+		mLiveBytes -= GetSize(original);
+		mInner->Free(original);
+	}
+
+	virtual bool GetAllocationSize(void* original, SIZE_T& sizeOut) override { return mInner->GetAllocationSize(original, sizeOut); }
+	virtual SIZE_T QuantizeSize(SIZE_T count, uint32 alignment) override { return mInner->QuantizeSize(count, alignment); }
+	virtual void Trim(bool bTrimThreadCaches) override { mInner->Trim(bTrimThreadCaches); }
+	virtual void SetupTLSCachesOnCurrentThread() override { mInner->SetupTLSCachesOnCurrentThread(); }
+	virtual void ClearAndDisableTLSCachesOnCurrentThread() override { mInner->ClearAndDisableTLSCachesOnCurrentThread(); }
+	virtual bool IsInternallyThreadSafe() const override { return mInner->IsInternallyThreadSafe(); }
+	virtual bool ValidateHeap() override { return mInner->ValidateHeap(); }
+	virtual void GetAllocatorStats(FGenericMemoryStats& outStats) override { mInner->GetAllocatorStats(outStats); }
+	virtual void DumpAllocatorStats(FOutputDevice& Ar) override { mInner->DumpAllocatorStats(Ar); }
+	virtual void UpdateStats() override { mInner->UpdateStats(); }
+	virtual const TCHAR* GetDescriptiveName() override { return TEXT("ChunkBenchmark"); }
+
+private:
+	FMalloc* mInner;
+
+	std::atomic<int64> mAllocations{ 0 };
+	std::atomic<int64> mLiveBytes{ 0 };
+	std::atomic<int64> mBaseBytes{ 0 };
+	std::atomic<int64> mPeakBytes{ 0 };
+
+	int64 GetSize(void* original)
+	{
+		SIZE_T size = 0;
+		return original && mInner->GetAllocationSize(original, size) ? int64(size) : 0;
+	}
+
+	void AddBytes(int64 bytes)
+	{
+		int64 live = mLiveBytes += bytes;
+		int64 peak = mPeakBytes.load();
+		while (live > peak && !mPeakBytes.compare_exchange_weak(peak, live)) {}
+	}
+};
+
+// World block coordinates to a block, x and y along k and j, z is i
+typedef TFunction<BlockType(int32 x, int32 y, int32 z)> FBenchmarkTerrainFunction;
+
+class FBenchmarkTerrain : public IChunkGenerator
+{
+public:
+	explicit FBenchmarkTerrain(FBenchmarkTerrainFunction function) : mFunction(MoveTemp(function)) {}
+
+	virtual void GenerateSection(int32 ChunkX, int32 ChunkY, int32 section, int32 sectionSide, BlockType* out) const override
+	{
+		int32 b = 0;
+		for (int32 localI = 0; localI < sectionSide; localI++)
+			for (int32 j = 0; j < sectionSide; j++)
+				for (int32 k = 0; k < sectionSide; k++, b++)
+					out[b] = mFunction(ChunkX * sectionSide + k, ChunkY * sectionSide + j, section * sectionSide + localI);
+	}
+
+private:
+	FBenchmarkTerrainFunction mFunction;
+};
+
+static TSharedPtr<IChunkGenerator> MakeBenchmarkTerrain(const FString& name)
+{
+	if (name == TEXT("flat"))
+	{
+		return MakeShared<FBenchmarkTerrain>([](int32 x, int32 y, int32 z) {
+			return z < 63 ? BlockType::STONE : (z == 63 ? BlockType::GRASS : BlockType::AIR);
+		});
+	}
+
+	if (name == TEXT("sine"))
+	{
+		return MakeShared<FBenchmarkTerrain>([](int32 x, int32 y, int32 z) {
+			int32 height = 64 + FMath::RoundToInt(12.0f * FMath::Sin(x * 0.15f) + 12.0f * FMath::Cos(y * 0.11f));
+			return z < height - 1 ? BlockType::DIRT : (z == height - 1 ? BlockType::GRASS : BlockType::AIR);
+		});
+	}
+
+	// Every block has all six faces exposed, the most a section can have
+	if (name == TEXT("checkerboard"))
+	{
+		return MakeShared<FBenchmarkTerrain>([](int32 x, int32 y, int32 z) {
+			return z < 64 && ((x + y + z) & 1) ? BlockType::STONE : BlockType::AIR;
+		});
+	}
+
+	// The default world with a fixed seed, and a version with much bigger caves
+	FTerrainGenerationParams params;
+	params.Seed = 1337;
+
+	if (name == TEXT("noisy"))
+	{
+		params.CaveThreshold = 1.0f;
+		return MakeShared<FNoiseTerrainGenerator>(params);
+	}
+
+	if (name == TEXT("caves"))
+	{
+		params.CaveFrequency = 0.08f;
+		params.CaveThreshold = 0.15f;
+		params.CaveSurfaceDepth = 2;
+		return MakeShared<FNoiseTerrainGenerator>(params);
+	}
+
+	return nullptr;
+}
+
+struct FBenchmarkResult
+{
+	FString Terrain;
+	FString Stage;
+	bool bParallel = false;
+	int32 Chunks = 0;
+	int32 Sections = 0;
+	double Seconds = 0.0;
+	int64 Vertices = 0;
+	int64 Allocations = 0;
+	int64 PeakBytes = 0;
+
+	double PerSecond(int32 count) const { return Seconds > 0.0 ? count / Seconds : 0.0; }
+};
+
+UChunkBenchmarkCommandlet::UChunkBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+	HelpDescription = TEXT("Times chunk generation and meshing on fixed terrains and writes the results as JSON");
+}
+
+int32 UChunkBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 chunkCount = 64, iterations = 3;
+	FParse::Value(*Params, TEXT("Chunks="), chunkCount);
+	FParse::Value(*Params, TEXT("Iterations="), iterations);
+	iterations = FMath::Max(iterations, 1);
+
+	// A square of chunks from 0, 0
+	int32 side = FMath::Max(1, FMath::CeilToInt(FMath::Sqrt(float(chunkCount))));
+	chunkCount = side * side;
+
+	FString terrainList = TEXT("flat,sine,noisy,checkerboard,caves");
+	FParse::Value(*Params, TEXT("Terrains="), terrainList, false);
+	TArray<FString> terrains;
+	terrainList.ParseIntoArray(terrains, TEXT(","));
+
+	FString outputPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), TEXT("ChunkBenchmark.json"));
+	FString csvPath;
+	FParse::Value(*Params, TEXT("Output="), outputPath);
+	FParse::Value(*Params, TEXT("Csv="), csvPath);
+
+	// Never destroyed, a thread can still be inside it after GMalloc is put back
+	static FBenchmarkMalloc* benchmarkMalloc = nullptr;
+	FMalloc* previousMalloc = GMalloc;
+#if !PLATFORM_USES_FIXED_GMalloc_CLASS
+	if (!benchmarkMalloc) benchmarkMalloc = new FBenchmarkMalloc(GMalloc);
+	GMalloc = benchmarkMalloc;
+#endif
+
+	TArray<FBenchmarkResult> results;
+
+	for (const FString& terrain : terrains)
+	{
+		TSharedPtr<IChunkGenerator> generator = MakeBenchmarkTerrain(terrain);
+		if (!generator.IsValid())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Unknown terrain %s"), *terrain);
+			continue;
+		}
+
+		for (int32 parallel = 0; parallel < 2; parallel++)
+		{
+			TArray<FChunkBlockStorage> chunks;
+
+			// Stage 0 generates, then meshing per face and greedy on the generated blocks
+			const TCHAR* STAGE_NAMES[3] = { TEXT("generate"), TEXT("mesh"), TEXT("mesh_greedy") };
+			for (int32 stage = 0; stage < 3; stage++)
+			{
+				FBenchmarkResult best;
+				best.Terrain = terrain; best.Stage = STAGE_NAMES[stage]; best.bParallel = parallel != 0;
+				best.Chunks = chunkCount; best.Seconds = TNumericLimits<double>::Max();
+
+				for (int32 iteration = 0; iteration < iterations; iteration++)
+				{
+					// The noise generators cache their 2D fields, a fresh one every iteration times them too
+					if (stage == 0) generator = MakeBenchmarkTerrain(terrain);
+
+					TArray<FChunkBlockStorage> generated;
+					TArray<TArray<MeshData*>> meshes;
+					if (stage == 0) generated.SetNum(chunkCount);
+					else meshes.SetNum(chunkCount);
+
+					MeshingMode mode = stage == 2 ? MeshingMode::GREEDY : MeshingMode::PER_FACE;
+					TFunction<void(int32)> body = [&](int32 c)
+					{
+						int32 dummy;
+						if (stage == 0)
+							generated[c] = AChunk::GenerateChunkData(c % side, c / side, 16, 16, dummy, dummy, *generator);
+						else
+							meshes[c] = AChunk::GetMeshDataForChunk(c % side, c / side, FChunkVolumeView(chunks[c]), mode);
+					};
+
+					if (benchmarkMalloc) benchmarkMalloc->Reset();
+					double start = FPlatformTime::Seconds();
+
+					if (parallel) ParallelFor(chunkCount, body);
+					else for (int32 c = 0; c < chunkCount; c++) body(c);
+
+					double seconds = FPlatformTime::Seconds() - start;
+
+					FBenchmarkResult result = best;
+					result.Seconds = seconds;
+					result.Allocations = benchmarkMalloc ? benchmarkMalloc->GetAllocations() : -1;
+					result.PeakBytes = benchmarkMalloc ? benchmarkMalloc->GetPeakBytes() : -1;
+
+					for (int32 c = 0; c < chunkCount; c++)
+					{
+						if (stage == 0)
+						{
+							result.Sections += generated[c].GetSectionCount();
+							continue;
+						}
+
+						result.Sections += meshes[c].Num();
+						for (MeshData* d : meshes[c])
+						{
+							result.Vertices += d->GetVertexCount();
+							FMeshDataPool::Release(d);
+						}
+					}
+
+					if (seconds < best.Seconds) best = result;
+					if (stage == 0 && iteration == iterations - 1) chunks = MoveTemp(generated);
+				}
+
+				results.Add(best);
+
+				UE_LOG(LogTemp, Display, TEXT("%-12s %-11s %-6s %8.1f chunks/s %9.1f sections/s %7.1f vertices/section %9lld allocations %8.2f MB peak"),
+					*best.Terrain, *best.Stage, best.bParallel ? TEXT("multi") : TEXT("single"),
+					best.PerSecond(best.Chunks), best.PerSecond(best.Sections),
+					best.Sections > 0 ? double(best.Vertices) / best.Sections : 0.0,
+					best.Allocations, best.PeakBytes / (1024.0 * 1024.0));
+			}
+		}
+	}
+
+	// Freed while they're still counted
+	FMeshDataPool::Empty();
+	GMalloc = previousMalloc;
+
+	TSharedRef<FJsonObject> root = MakeShared<FJsonObject>();
+	root->SetNumberField(TEXT("version"), 1);
+	root->SetStringField(TEXT("timestamp"), FDateTime::UtcNow().ToIso8601());
+	root->SetStringField(TEXT("build"), FApp::GetBuildVersion());
+	root->SetStringField(TEXT("configuration"), LexToString(FApp::GetBuildConfiguration()));
+	root->SetStringField(TEXT("cpu"), FPlatformMisc::GetCPUBrand().TrimStartAndEnd());
+	root->SetNumberField(TEXT("cores"), FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+	root->SetNumberField(TEXT("chunks"), chunkCount);
+	root->SetNumberField(TEXT("iterations"), iterations);
+
+	TArray<TSharedPtr<FJsonValue>> jsonResults;
+	FString csv = TEXT("terrain,stage,threads,chunks,sections,seconds,chunks_per_second,sections_per_second,vertices_per_section,allocations,peak_bytes\n");
+
+	for (const FBenchmarkResult& result : results)
+	{
+		double verticesPerSection = result.Sections > 0 ? double(result.Vertices) / result.Sections : 0.0;
+
+		TSharedRef<FJsonObject> entry = MakeShared<FJsonObject>();
+		entry->SetStringField(TEXT("terrain"), result.Terrain);
+		entry->SetStringField(TEXT("stage"), result.Stage);
+		entry->SetStringField(TEXT("threads"), result.bParallel ? TEXT("multi") : TEXT("single"));
+		entry->SetNumberField(TEXT("chunks"), result.Chunks);
+		entry->SetNumberField(TEXT("sections"), result.Sections);
+		entry->SetNumberField(TEXT("seconds"), result.Seconds);
+		entry->SetNumberField(TEXT("chunksPerSecond"), result.PerSecond(result.Chunks));
+		entry->SetNumberField(TEXT("sectionsPerSecond"), result.PerSecond(result.Sections));
+		entry->SetNumberField(TEXT("verticesPerSection"), verticesPerSection);
+		entry->SetNumberField(TEXT("allocations"), double(result.Allocations));
+		entry->SetNumberField(TEXT("peakBytes"), double(result.PeakBytes));
+		jsonResults.Add(MakeShared<FJsonValueObject>(entry));
+
+		csv += FString::Printf(TEXT("%s,%s,%s,%d,%d,%f,%f,%f,%f,%lld,%lld\n"), *result.Terrain, *result.Stage,
+			result.bParallel ? TEXT("multi") : TEXT("single"), result.Chunks, result.Sections, result.Seconds,
+			result.PerSecond(result.Chunks), result.PerSecond(result.Sections), verticesPerSection,
+			result.Allocations, result.PeakBytes);
+	}
+
+	root->SetArrayField(TEXT("results"), jsonResults);
+
+	FString json;
+	TSharedRef<TJsonWriter<>> writer = TJsonWriterFactory<>::Create(&json);
+	FJsonSerializer::Serialize(root, writer);
+
+	bool bWritten = FFileHelper::SaveStringToFile(json, *outputPath);
+	if (!csvPath.IsEmpty()) bWritten &= FFileHelper::SaveStringToFile(csv, *csvPath);
+
+	UE_LOG(LogTemp, Display, TEXT("Chunk benchmark results written to %s"), *outputPath);
+	return bWritten ? 0 : 1;
+}
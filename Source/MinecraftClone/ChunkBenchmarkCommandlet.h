@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ChunkBenchmarkCommandlet.generated.h"
+
+// Times chunk generation and meshing on fixed terrains without starting the game, so it runs on a
+// build machine without a GPU:
+//   UnrealEditor-Cmd MinecraftClone.uproject -run=ChunkBenchmark -nullrhi -unattended
+// Options: -Chunks=64 -Iterations=3 -Terrains=flat,sine,noisy,checkerboard,caves
+//          -Output=<json file> -Csv=<csv file>
+// Every stage runs on this thread and spread over the task graph. The fastest iteration of each is
+// reported, with chunks/s, sections/s, vertices per section, allocations and peak memory.
+UCLASS()
+class MINECRAFTCLONE_API UChunkBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UChunkBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,366 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkBlockStorage.h"
+#include "Chunk.h"
+#include "SectionFaceMasks.h"
+
+FChunkBlockStorage::FChunkBlockStorage(int32 sectionSide, int32 sectionCount, BlockType fill)
+{
+	Init(sectionSide, sectionCount, fill);
+}
+
+void FChunkBlockStorage::Init(int32 sectionSide, int32 sectionCount, BlockType fill)
+{
+	mSectionSide = sectionSide; mSectionCount = sectionCount;
+
+	mSections.Empty(sectionCount);
+	mSections.SetNum(sectionCount);
+
+	bool solid = fill != BlockType::AIR, opaque = FBlockRegistry::IsOpaque(fill);
+	for (FSection& section : mSections)
+	{
+		section.Palette.Add(fill);
+		section.PaletteCounts.Add(GetBlocksPerSection());
+
+		section.SolidCount = solid ? GetBlocksPerSection() : 0;
+		section.OpaqueCount = opaque ? GetBlocksPerSection() : 0;
+		for (int32 face = 0; face < 6; face++)
+		{
+			section.FaceSolidCount[face] = solid ? mSectionSide * mSectionSide : 0;
+			section.FaceOpaqueCount[face] = opaque ? mSectionSide * mSectionSide : 0;
+		}
+	}
+}
+
+void FChunkBlockStorage::SetAll(const TArray<BlockType>& blocks, int32 sectionSide, int32 sectionCount)
+{
+	Init(sectionSide, sectionCount, BlockType::AIR);
+
+	// i is the slowest axis, so each section is a contiguous run of the flat array
+	for (int32 section = 0; section < sectionCount; section++)
+		SetSection(section, blocks.GetData() + section * GetBlocksPerSection());
+}
+
+void FChunkBlockStorage::SetSection(int32 section, const BlockType* blocks)
+{
+	FSection& target = mSections[section];
+	target.Palette.Reset();
+	target.PaletteCounts.Reset();
+	target.Indices.Empty();
+	target.BitsPerIndex = 0;
+
+	// Palette index of every block type seen so far, 0xFFFF if not in the palette
+	uint16 paletteIndex[256];
+	FMemory::Memset(paletteIndex, 0xFF, sizeof(paletteIndex));
+
+	int32 blocksPerSection = GetBlocksPerSection();
+	for (int32 b = 0; b < blocksPerSection; b++)
+	{
+		if (paletteIndex[uint8(blocks[b])] == 0xFFFF)
+		{
+			paletteIndex[uint8(blocks[b])] = target.Palette.Num();
+			target.Palette.Add(blocks[b]);
+			target.PaletteCounts.Add(0);
+		}
+		target.PaletteCounts[paletteIndex[uint8(blocks[b])]]++;
+	}
+
+	UpdateSummary(target, blocks);
+
+	target.BitsPerIndex = GetBitsForPaletteSize(target.Palette.Num());
+	if (target.BitsPerIndex == 0) return;
+
+	target.Indices.SetNumZeroed(FMath::DivideAndRoundUp(blocksPerSection * target.BitsPerIndex, 32));
+	for (int32 b = 0; b < blocksPerSection; b++)
+		WriteIndex(target, b, paletteIndex[uint8(blocks[b])]);
+}
+
+void FChunkBlockStorage::GetSection(int32 section, BlockType* out) const
+{
+	const FSection& source = mSections[section];
+	int32 blocksPerSection = GetBlocksPerSection();
+
+	if (source.BitsPerIndex == 0)
+	{
+		FMemory::Memset(out, uint8(source.Palette[0]), blocksPerSection);
+		return;
+	}
+
+	for (int32 b = 0; b < blocksPerSection; b++)
+		out[b] = source.Palette[ReadIndex(source, b)];
+}
+
+void FChunkBlockStorage::Set(int i, int j, int k, BlockType blockType)
+{
+	FSection& section = mSections[i / mSectionSide];
+	int32 indexInSection = GetIndexInSection(i, j, k);
+
+	int32 oldIndex = section.BitsPerIndex == 0 ? 0 : ReadIndex(section, indexInSection);
+	BlockType oldBlockType = section.Palette[oldIndex];
+	if (oldBlockType == blockType) return;
+
+	int32 index = section.Palette.Find(blockType);
+	if (index == INDEX_NONE)
+	{
+		index = section.Palette.Add(blockType);
+		section.PaletteCounts.Add(0);
+
+		uint8 bitsPerIndex = GetBitsForPaletteSize(section.Palette.Num());
+		if (bitsPerIndex != section.BitsPerIndex) Repack(section, bitsPerIndex);
+	}
+
+	section.PaletteCounts[oldIndex]--;
+	section.PaletteCounts[index]++;
+
+	// Keep the summary in sync
+	uint8 faces = GetFacesOfPosition(i % mSectionSide, j, k);
+	bool wasSolid = oldBlockType != BlockType::AIR, isSolid = blockType != BlockType::AIR;
+	if (wasSolid != isSolid)
+	{
+		int32 delta = isSolid ? 1 : -1;
+		section.SolidCount += delta;
+
+		for (int32 face = 0; face < 6; face++)
+			if (faces & (1 << face)) section.FaceSolidCount[face] += delta;
+	}
+
+	bool wasOpaque = FBlockRegistry::IsOpaque(oldBlockType), isOpaque = FBlockRegistry::IsOpaque(blockType);
+	if (wasOpaque != isOpaque)
+	{
+		int32 delta = isOpaque ? 1 : -1;
+		section.OpaqueCount += delta;
+
+		for (int32 face = 0; face < 6; face++)
+			if (faces & (1 << face)) section.FaceOpaqueCount[face] += delta;
+	}
+
+	// Edited back into a single block type, drop the packed indices
+	if (section.PaletteCounts[index] == GetBlocksPerSection())
+	{
+		section.Palette.Reset(); section.Palette.Add(blockType);
+		section.PaletteCounts.Reset(); section.PaletteCounts.Add(GetBlocksPerSection());
+		section.Indices.Empty();
+		section.BitsPerIndex = 0;
+		return;
+	}
+
+	WriteIndex(section, indexInSection, index);
+}
+
+bool FChunkBlockStorage::IsSectionUniform(int32 section, BlockType& blockType) const
+{
+	const FSection& source = mSections[section];
+
+	// Palette entries aren't removed on Set, so look for the one used by every block
+	for (int32 p = 0; p < source.Palette.Num(); p++)
+	{
+		if (source.PaletteCounts[p] == GetBlocksPerSection())
+		{
+			blockType = source.Palette[p];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+SIZE_T FChunkBlockStorage::GetAllocatedSize() const
+{
+	SIZE_T size = mSections.GetAllocatedSize();
+	for (const FSection& section : mSections)
+		size += section.Palette.GetAllocatedSize() + section.PaletteCounts.GetAllocatedSize() + section.Indices.GetAllocatedSize();
+
+	return size;
+}
+
+void FChunkBlockStorage::Serialize(FArchive& Ar)
+{
+	if (!Ar.IsLoading())
+	{
+		Save(Ar);
+		return;
+	}
+
+	Ar << mSectionSide << mSectionCount;
+
+	// At most 32 sections (see AChunk::mSectionVersions), of sections the face masks can mesh
+	if (mSectionSide <= 0 || mSectionSide > FSectionFaceMasks::MaxSectionSide || mSectionCount <= 0 || mSectionCount > 32)
+		Ar.SetError();
+	if (Ar.IsError())
+	{
+		Empty();
+		return;
+	}
+
+	mSections.Empty(mSectionCount);
+	mSections.SetNum(mSectionCount);
+
+	int32 blocksPerSection = GetBlocksPerSection();
+	TArray<BlockType> blocks;
+	blocks.SetNumUninitialized(blocksPerSection);
+	for (int32 s = 0; s < mSectionCount; s++)
+	{
+		FSection& section = mSections[s];
+
+		uint16 paletteSize = 0;
+		Ar << paletteSize << section.BitsPerIndex;
+
+		if (paletteSize == 0 || paletteSize > 256 || section.BitsPerIndex != GetBitsForPaletteSize(paletteSize))
+		{
+			Ar.SetError();
+			break;
+		}
+
+		int32 indexWords = section.BitsPerIndex == 0 ? 0 : FMath::DivideAndRoundUp(blocksPerSection * section.BitsPerIndex, 32);
+		section.Palette.SetNumUninitialized(paletteSize);
+		section.PaletteCounts.SetNumUninitialized(paletteSize);
+		section.Indices.SetNumUninitialized(indexWords);
+
+		// BlockType is a byte, the arrays go as raw memory, in the same layout Save writes them
+		Ar.Serialize(section.Palette.GetData(), paletteSize * sizeof(BlockType));
+		Ar.Serialize(section.PaletteCounts.GetData(), paletteSize * sizeof(uint16));
+		Ar.Serialize(section.Indices.GetData(), indexWords * sizeof(uint32));
+
+		Ar << section.SolidCount;
+		for (int32 face = 0; face < 6; face++) Ar << section.FaceSolidCount[face];
+
+		if (Ar.IsError()) break;
+
+		// Get reads the palette without checking the index, a corrupted one would read past it
+		if (section.BitsPerIndex > 0)
+		{
+			for (int32 b = 0; b < blocksPerSection && !Ar.IsError(); b++)
+				if (ReadIndex(section, b) >= paletteSize) Ar.SetError();
+			if (Ar.IsError()) break;
+		}
+
+		// Set decrements the counts, one that doesn't match the blocks would wrap around, so the saved
+		// counts are only skipped over and everything is counted again from the blocks
+		FMemory::Memzero(section.PaletteCounts.GetData(), paletteSize * sizeof(uint16));
+		if (section.BitsPerIndex == 0) section.PaletteCounts[0] = blocksPerSection;
+		else
+		{
+			for (int32 b = 0; b < blocksPerSection; b++) section.PaletteCounts[ReadIndex(section, b)]++;
+		}
+
+		GetSection(s, blocks.GetData());
+		UpdateSummary(section, blocks.GetData());
+	}
+
+	if (Ar.IsError()) Empty();
+}
+
+void FChunkBlockStorage::Save(FArchive& Ar) const
+{
+	check(!Ar.IsLoading());
+
+	int32 sectionSide = mSectionSide, sectionCount = mSectionCount;
+	Ar << sectionSide << sectionCount;
+
+	for (const FSection& section : mSections)
+	{
+		uint16 paletteSize = section.Palette.Num();
+		uint8 bitsPerIndex = section.BitsPerIndex;
+		Ar << paletteSize << bitsPerIndex;
+
+		// Value by value through copies, the archive takes non const references. Same bytes as the raw arrays
+		for (BlockType blockType : section.Palette)
+		{
+			uint8 value = uint8(blockType);
+			Ar << value;
+		}
+		for (uint16 count : section.PaletteCounts)
+		{
+			uint16 value = count;
+			Ar << value;
+		}
+		for (uint32 word : section.Indices)
+		{
+			uint32 value = word;
+			Ar << value;
+		}
+
+		uint16 solidCount = section.SolidCount;
+		Ar << solidCount;
+		for (int32 face = 0; face < 6; face++)
+		{
+			uint16 faceSolidCount = section.FaceSolidCount[face];
+			Ar << faceSolidCount;
+		}
+	}
+}
+
+void FChunkBlockStorage::Empty()
+{
+	mSections.Empty();
+	mSectionSide = 0; mSectionCount = 0;
+}
+
+uint8 FChunkBlockStorage::GetBitsForPaletteSize(int32 paletteSize)
+{
+	if (paletteSize <= 1) return 0;
+	if (paletteSize <= 2) return 1;
+	if (paletteSize <= 4) return 2;
+	if (paletteSize <= 16) return 4;
+	return 8;
+}
+
+uint8 FChunkBlockStorage::GetFacesOfPosition(int32 localI, int32 j, int32 k) const
+{
+	int32 last = mSectionSide - 1;
+
+	return (localI == last ? 1 << 0 : 0) | (localI == 0 ? 1 << 1 : 0) |
+		(k == 0 ? 1 << 2 : 0) | (k == last ? 1 << 3 : 0) |
+		(j == 0 ? 1 << 4 : 0) | (j == last ? 1 << 5 : 0);
+}
+
+void FChunkBlockStorage::UpdateSummary(FSection& section, const BlockType* blocks) const
+{
+	section.SolidCount = 0;
+	section.OpaqueCount = 0;
+	FMemory::Memzero(section.FaceSolidCount, sizeof(section.FaceSolidCount));
+	FMemory::Memzero(section.FaceOpaqueCount, sizeof(section.FaceOpaqueCount));
+
+	int32 b = 0;
+	for (int32 localI = 0; localI < mSectionSide; localI++)
+	{
+		for (int32 j = 0; j < mSectionSide; j++)
+		{
+			for (int32 k = 0; k < mSectionSide; k++, b++)
+			{
+				if (blocks[b] == BlockType::AIR) continue;
+
+				bool opaque = FBlockRegistry::IsOpaque(blocks[b]);
+				section.SolidCount++;
+				section.OpaqueCount += opaque;
+
+				uint8 faces = GetFacesOfPosition(localI, j, k);
+				for (int32 face = 0; face < 6; face++)
+				{
+					if (!(faces & (1 << face))) continue;
+					section.FaceSolidCount[face]++;
+					section.FaceOpaqueCount[face] += opaque;
+				}
+			}
+		}
+	}
+}
+
+void FChunkBlockStorage::Repack(FSection& section, uint8 bitsPerIndex) const
+{
+	int32 blocksPerSection = GetBlocksPerSection();
+
+	FSection repacked;
+	repacked.BitsPerIndex = bitsPerIndex;
+	repacked.Indices.SetNumZeroed(FMath::DivideAndRoundUp(blocksPerSection * bitsPerIndex, 32));
+
+	// Going from a uniform section every block is palette index 0, which is already zeroed
+	if (section.BitsPerIndex != 0)
+	{
+		for (int32 b = 0; b < blocksPerSection; b++)
+			WriteIndex(repacked, b, ReadIndex(section, b));
+	}
+
+	section.Indices = MoveTemp(repacked.Indices);
+	section.BitsPerIndex = bitsPerIndex;
+}
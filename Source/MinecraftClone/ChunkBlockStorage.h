@@ -0,0 +1,137 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+enum class BlockType : uint8;
+
+// Block storage of a chunk with one palette per section. A section made of a single block type only
+// stores that type, otherwise every block is an index into the section palette, packed with 1, 2, 4
+// or 8 bits per block depending on the palette size. Blocks are addressed with the same i (height),
+// j, k coordinates as the rest of AChunk.
+// Every section also keeps a summary that is updated on each Set, so the mesher can tell empty and
+// buried sections apart without scanning them: how many blocks aren't AIR, whether it's a single
+// block type and how many blocks each of its 6 faces has (in MeshData::Direction order), all of it
+// counted again for the opaque blocks only (see FBlockRegistry). The opaque counts aren't saved,
+// they depend on the registry and are rebuilt on load.
+class MINECRAFTCLONE_API FChunkBlockStorage
+{
+public:
+	FChunkBlockStorage() {}
+	FChunkBlockStorage(int32 sectionSide, int32 sectionCount, BlockType fill);
+
+	// Every section becomes uniform with the fill block
+	void Init(int32 sectionSide, int32 sectionCount, BlockType fill);
+
+	// Builds the storage from a flat array in GetPositionInTArray order
+	void SetAll(const TArray<BlockType>& blocks, int32 sectionSide, int32 sectionCount);
+
+	// Replaces a whole section, blocks holds sectionSide^3 blocks in GetPositionInTArray order
+	void SetSection(int32 section, const BlockType* blocks);
+
+	// Decodes a whole section into out, which needs room for sectionSide^3 blocks
+	void GetSection(int32 section, BlockType* out) const;
+
+	FORCEINLINE BlockType Get(int i, int j, int k) const
+	{
+		const FSection& section = mSections[i / mSectionSide];
+		if (section.BitsPerIndex == 0) return section.Palette[0];
+
+		return section.Palette[ReadIndex(section, GetIndexInSection(i, j, k))];
+	}
+
+	void Set(int i, int j, int k, BlockType blockType);
+
+	// A uniform section is made of a single block type, returned in blockType
+	bool IsSectionUniform(int32 section, BlockType& blockType) const;
+
+	// Number of non AIR blocks in the section
+	int32 GetSolidCount(int32 section) const { return mSections[section].SolidCount; }
+
+	bool IsSectionEmpty(int32 section) const { return mSections[section].SolidCount == 0; }
+
+	bool IsSectionFull(int32 section) const { return mSections[section].SolidCount == GetBlocksPerSection(); }
+
+	// Every block of the section is opaque, so it hides everything behind it
+	bool IsSectionOpaque(int32 section) const { return mSections[section].OpaqueCount == GetBlocksPerSection(); }
+
+	// True if every block on that face of the section is opaque, face is a MeshData::Direction
+	bool IsSectionFaceOpaque(int32 section, int32 face) const
+	{
+		return mSections[section].FaceOpaqueCount[face] == mSectionSide * mSectionSide;
+	}
+
+	int32 GetSectionSide() const { return mSectionSide; }
+	int32 GetSectionCount() const { return mSectionCount; }
+	bool IsEmpty() const { return mSections.Num() == 0; }
+
+	// Bytes allocated for the palettes and the packed indices
+	SIZE_T GetAllocatedSize() const;
+
+	// Saves or loads the palettes and packed indices as they are, so loading doesn't re-encode anything,
+	// the counts and summaries are counted again from the loaded blocks. Data that doesn't make sense
+	// sets the archive error and empties the storage
+	void Serialize(FArchive& Ar);
+
+	// The saving half of Serialize
+	void Save(FArchive& Ar) const;
+
+	// Most bytes Serialize can write, for 32 sections of 32 blocks with 256 block types each
+	static const int32 MaxSerializedSize = 2 * sizeof(int32) +
+		32 * (sizeof(uint16) + sizeof(uint8) + 256 * (sizeof(BlockType) + sizeof(uint16)) + 32 * 32 * 32 + 7 * sizeof(uint16));
+
+	void Empty();
+
+private:
+	struct FSection
+	{
+		TArray<BlockType, TInlineAllocator<4>> Palette;
+		// How many blocks use each palette entry
+		TArray<uint16, TInlineAllocator<4>> PaletteCounts;
+		TArray<uint32> Indices;
+		uint8 BitsPerIndex = 0;
+
+		uint16 SolidCount = 0;
+		uint16 FaceSolidCount[6] = { 0, 0, 0, 0, 0, 0 };
+
+		uint16 OpaqueCount = 0;
+		uint16 FaceOpaqueCount[6] = { 0, 0, 0, 0, 0, 0 };
+	};
+
+	TArray<FSection> mSections;
+	int32 mSectionSide = 0;
+	int32 mSectionCount = 0;
+
+	FORCEINLINE int32 GetIndexInSection(int i, int j, int k) const
+	{
+		return ((i % mSectionSide) * mSectionSide + j) * mSectionSide + k;
+	}
+
+	// BitsPerIndex always divides 32, so an index never straddles two words
+	static FORCEINLINE uint32 ReadIndex(const FSection& section, int32 index)
+	{
+		int32 bit = index * section.BitsPerIndex;
+		return (section.Indices[bit >> 5] >> (bit & 31)) & ((1u << section.BitsPerIndex) - 1);
+	}
+
+	static FORCEINLINE void WriteIndex(FSection& section, int32 index, uint32 value)
+	{
+		int32 bit = index * section.BitsPerIndex;
+		uint32 mask = ((1u << section.BitsPerIndex) - 1) << (bit & 31);
+		section.Indices[bit >> 5] = (section.Indices[bit >> 5] & ~mask) | (value << (bit & 31));
+	}
+
+	static uint8 GetBitsForPaletteSize(int32 paletteSize);
+
+	// Bit d is set if the local position lies on face d of the section (MeshData::Direction order)
+	uint8 GetFacesOfPosition(int32 localI, int32 j, int32 k) const;
+
+	// Rebuilds the solid and opaque counts of a section from scratch
+	void UpdateSummary(FSection& section, const BlockType* blocks) const;
+
+	// Re-encodes the indices of the section with a new number of bits per index
+	void Repack(FSection& section, uint8 bitsPerIndex) const;
+
+	int32 GetBlocksPerSection() const { return mSectionSide * mSectionSide * mSectionSide; }
+};
@@ -0,0 +1,223 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkCollisionQueue.h"
+#include "Async/Async.h"
+#include "ChunkStats.h"
+
+void FChunkCollisionQueue::AddActor(AActor* actor)
+{
+	if (actor) mActors.AddUnique(actor);
+}
+
+void FChunkCollisionQueue::RemoveActor(AActor* actor)
+{
+	mActors.Remove(actor);
+}
+
+void FChunkCollisionQueue::Tick()
+{
+	CHUNK_STAGE_SCOPE(STAT_ChunkCollision, Collision);
+
+	for (int32 j = mJobs.Num() - 1; j >= 0; j--)
+	{
+		if (!mJobs[j].Result.IsReady()) continue;
+
+		// Released, or lost its collision while the job was running
+		AChunk* chunk = mJobs[j].Chunk.Get();
+		if (IsValid(chunk) && chunk->mHasCollision && chunk->mCollisionVersion == mJobs[j].Version)
+			chunk->SetCollisionBoxes(mJobs[j].Result.Get());
+
+		mJobs.RemoveAtSwap(j);
+	}
+
+	mActors.RemoveAll([](const TWeakObjectPtr<AActor>& actor) { return !actor.IsValid(); });
+
+	TArray<FIntPoint, TInlineAllocator<8>> centers;
+	for (const TWeakObjectPtr<AActor>& actor : mActors)
+	{
+		FVector location = actor->GetActorLocation();
+		centers.Add(FIntPoint(floor(location.X / 1600.0f), floor(location.Y / 1600.0f)));
+	}
+
+	// Demote first, one chunk of margin so walking along a chunk wall doesn't flip them every frame
+	for (int32 c = mCollidingChunks.Num() - 1; c >= 0; c--)
+	{
+		AChunk* chunk = mCollidingChunks[c].Get();
+		if (!IsValid(chunk) || !chunk->mHasCollision)
+		{
+			mCollidingChunks.RemoveAtSwap(c);
+			continue;
+		}
+
+		int32 distance = MAX_int32;
+		for (const FIntPoint& center : centers)
+			distance = FMath::Min(distance, FMath::Max(FMath::Abs(chunk->mChunkX - center.X), FMath::Abs(chunk->mChunkY - center.Y)));
+
+		if (distance > CollisionDistance + 1)
+		{
+			chunk->ClearCollision();
+			mCollidingChunks.RemoveAtSwap(c);
+		}
+	}
+
+	for (const FIntPoint& center : centers)
+	{
+		for (int32 dx = -CollisionDistance; dx <= CollisionDistance; dx++)
+		{
+			for (int32 dy = -CollisionDistance; dy <= CollisionDistance; dy++)
+			{
+				AChunk* chunk = AChunk::FindChunk(center.X + dx, center.Y + dy);
+				if (!chunk || chunk->mHasCollision) continue;
+
+				chunk->mHasCollision = true;
+				mCollidingChunks.Add(chunk);
+
+				// The actor is standing on it, usually only right after spawning since the chunks around
+				// are promoted before the actor gets there
+				if (dx == 0 && dy == 0)
+					chunk->SetCollisionBoxes(GetCollisionBoxes(chunk->mBlocks));
+				else
+					chunk->mCollisionDirty = true;
+			}
+		}
+	}
+
+	for (const TWeakObjectPtr<AChunk>& weakChunk : mCollidingChunks)
+	{
+		if (mJobs.Num() >= MaxJobsInFlight) break;
+
+		AChunk* chunk = weakChunk.Get();
+		if (!chunk->mCollisionDirty || IsInFlight(chunk)) continue;
+
+		chunk->mCollisionDirty = false;
+
+		FCollisionJob& job = mJobs.AddDefaulted_GetRef();
+		job.Chunk = chunk;
+		job.Version = chunk->mCollisionVersion;
+		job.Result = Async(EAsyncExecution::ThreadPool, [blocks = FChunkBlockStorage(chunk->mBlocks)]()
+		{
+			return GetCollisionBoxes(blocks);
+		});
+	}
+}
+
+void FChunkCollisionQueue::CancelAll()
+{
+	// The jobs own a copy of the blocks but read the block registry, which the next session reinitializes
+	for (FCollisionJob& job : mJobs)
+	{
+		job.Result.Wait();
+
+		AChunk* chunk = job.Chunk.Get();
+		if (IsValid(chunk) && chunk->mHasCollision) chunk->mCollisionDirty = true;
+	}
+
+	mJobs.Empty();
+}
+
+bool FChunkCollisionQueue::IsInFlight(const AChunk* chunk) const
+{
+	for (const FCollisionJob& job : mJobs)
+		if (job.Chunk.Get() == chunk) return true;
+
+	return false;
+}
+
+TArray<FBox> FChunkCollisionQueue::GetCollisionBoxes(const FChunkBlockStorage& blocks)
+{
+	CHUNK_STAGE_SCOPE(STAT_ChunkCollisionBoxes, CollisionBoxes);
+
+	TArray<FBox> boxes;
+
+	int32 side = blocks.GetSectionSide(), height = side * blocks.GetSectionCount();
+	if (side == 0) return boxes;
+
+	// One row of solidity bits along k per (i, j)
+	TArray<uint32> solid;
+	solid.SetNumZeroed(height * side);
+
+	TArray<BlockType> sectionBlocks;
+	sectionBlocks.SetNumUninitialized(side * side * side);
+	// Sections can be 32 blocks wide, shifting by 32 is undefined
+	uint32 fullRow = side >= 32 ? ~0u : (1u << side) - 1;
+
+	for (int32 section = 0; section < blocks.GetSectionCount(); section++)
+	{
+		if (blocks.IsSectionEmpty(section)) continue;
+
+		// Opaque blocks are always solid
+		uint32* rows = solid.GetData() + section * side * side;
+		if (blocks.IsSectionOpaque(section))
+		{
+			for (int32 r = 0; r < side * side; r++) rows[r] = fullRow;
+			continue;
+		}
+
+		blocks.GetSection(section, sectionBlocks.GetData());
+		for (int32 b = 0; b < sectionBlocks.Num(); b++)
+			if (FBlockRegistry::IsSolid(sectionBlocks[b])) rows[b / side] |= 1u << (b % side);
+	}
+
+	// Blocks with a face towards AIR or the chunk walls, boxes without any of them are buried
+	TArray<uint32> exposed;
+	exposed.SetNumUninitialized(height * side);
+
+	uint32 innerBits = fullRow & ~1u & ~(1u << (side - 1));
+	for (int32 i = 0; i < height; i++)
+	{
+		for (int32 j = 0; j < side; j++)
+		{
+			uint32 row = solid[i * side + j];
+
+			// Nothing can reach the bottom of the world
+			uint32 covered = (row << 1) & (row >> 1) & innerBits;
+			covered &= i + 1 < height ? solid[(i + 1) * side + j] : 0;
+			covered &= i > 0 ? solid[(i - 1) * side + j] : ~0u;
+			covered &= j > 0 ? solid[i * side + j - 1] : 0;
+			covered &= j + 1 < side ? solid[i * side + j + 1] : 0;
+
+			exposed[i * side + j] = row & ~covered;
+		}
+	}
+
+	// Greedy boxes, grown along k, then j, then i
+	for (int32 i = 0; i < height; i++)
+	{
+		for (int32 j = 0; j < side; j++)
+		{
+			while (uint32 row = solid[i * side + j])
+			{
+				int32 k = FMath::CountTrailingZeros(row);
+				int32 width = FMath::CountTrailingZeros(~(row >> k));
+				uint32 mask = (width >= 32 ? ~0u : (1u << width) - 1) << k;
+
+				int32 depth = 1;
+				while (j + depth < side && (solid[i * side + j + depth] & mask) == mask) depth++;
+
+				int32 tall = 1;
+				for (; i + tall < height; tall++)
+				{
+					bool bFits = true;
+					for (int32 dj = 0; dj < depth && bFits; dj++)
+						bFits = (solid[(i + tall) * side + j + dj] & mask) == mask;
+					if (!bFits) break;
+				}
+
+				bool bExposed = false;
+				for (int32 di = 0; di < tall; di++)
+				{
+					for (int32 dj = 0; dj < depth; dj++)
+					{
+						solid[(i + di) * side + j + dj] &= ~mask;
+						bExposed |= (exposed[(i + di) * side + j + dj] & mask) != 0;
+					}
+				}
+
+				if (bExposed)
+					boxes.Add(FBox(FVector(k, j, i) * AChunk::BlockSize, FVector(k + width, j + depth, i + tall) * AChunk::BlockSize));
+			}
+		}
+	}
+
+	return boxes;
+}
@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Chunk.h"
+
+// Gives collision only to the chunks near the actors that need it. The render sections don't create
+// any collision, instead chunks within CollisionDistance of a registered actor get simple collision
+// made of boxes: the solid blocks (see FBlockRegistry) merged greedily along k, j and i, dropping the boxes buried under
+// other blocks. The boxes are computed on the thread pool from a copy of the blocks, and chunks lose
+// their collision again once every actor is more than CollisionDistance + 1 chunks away.
+// Block edits rebuild the boxes of their chunk. Everything but the jobs runs on the game thread.
+class MINECRAFTCLONE_API FChunkCollisionQueue
+{
+public:
+	// Chebyshev distance in chunks, 0 is only the chunk the actor is in
+	int32 CollisionDistance = 2;
+
+	int32 MaxJobsInFlight = 4;
+
+	void AddActor(AActor* actor);
+	void RemoveActor(AActor* actor);
+
+	// Applies the finished jobs, gives or takes collision as the actors move and starts the jobs of
+	// the chunks whose blocks changed
+	void Tick();
+
+	// Waits for the jobs in flight and drops them, the chunks keep whatever collision they have
+	void CancelAll();
+
+	int32 GetCollidingChunkCount() const { return mCollidingChunks.Num(); }
+
+	// Boxes covering the solid blocks of the chunk that touch AIR or the chunk walls, in actor space
+	static TArray<FBox> GetCollisionBoxes(const FChunkBlockStorage& blocks);
+
+private:
+	struct FCollisionJob
+	{
+		TWeakObjectPtr<AChunk> Chunk;
+		// AChunk::mCollisionVersion when the blocks were copied
+		uint32 Version;
+		TFuture<TArray<FBox>> Result;
+	};
+
+	TArray<FCollisionJob> mJobs;
+
+	TArray<TWeakObjectPtr<AActor>> mActors;
+
+	// Chunks with mHasCollision set
+	TArray<TWeakObjectPtr<AChunk>> mCollidingChunks;
+
+	bool IsInFlight(const AChunk* chunk) const;
+};
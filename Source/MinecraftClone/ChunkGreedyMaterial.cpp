@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkGreedyMaterial.h"
+#include "Chunk.h"
+#include "Engine/Texture2D.h"
+#include "Materials/Material.h"
+
+#if WITH_EDITOR
+#include "Materials/MaterialExpressionCustom.h"
+#include "Materials/MaterialExpressionDDX.h"
+#include "Materials/MaterialExpressionDDY.h"
+#include "Materials/MaterialExpressionTextureCoordinate.h"
+#include "Materials/MaterialExpressionTextureSample.h"
+#include "Materials/MaterialExpressionVertexColor.h"
+#endif
+
+// The texture of TileTextures_Mat, the per face material
+static const TCHAR* const ATLAS_TEXTURE = TEXT("/Game/Textures/TileTextures.TileTextures");
+
+UMaterialInterface* FChunkGreedyMaterial::mMaterial = nullptr;
+bool FChunkGreedyMaterial::bBuilt = false;
+
+UMaterialInterface* FChunkGreedyMaterial::Get()
+{
+	check(IsInGameThread());
+
+	// Built once, a missing atlas or a packaged build isn't going to change
+	if (!bBuilt)
+	{
+		bBuilt = true;
+		mMaterial = Build();
+		if (mMaterial) mMaterial->AddToRoot();
+	}
+
+	return mMaterial;
+}
+
+UMaterialInterface* FChunkGreedyMaterial::Build()
+{
+#if WITH_EDITOR
+	UTexture2D* atlas = LoadObject<UTexture2D>(nullptr, ATLAS_TEXTURE);
+	if (!atlas)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Can't build the greedy material, %s is missing"), ATLAS_TEXTURE);
+		return nullptr;
+	}
+
+	UMaterial* material = NewObject<UMaterial>(GetTransientPackage(), TEXT("TileTextures_Greedy_Mat"), RF_Transient);
+
+	// UV0 counts blocks along the quad, the alpha is the atlas cell / 255
+	UMaterialExpressionTextureCoordinate* repeat = NewObject<UMaterialExpressionTextureCoordinate>(material);
+	UMaterialExpressionVertexColor* vertexColor = NewObject<UMaterialExpressionVertexColor>(material);
+
+	const int32 atlasSize = MeshData::ATLAS_SIZE;
+	UMaterialExpressionCustom* cellUV = NewObject<UMaterialExpressionCustom>(material);
+	cellUV->OutputType = CMOT_Float2;
+	cellUV->Code = FString::Printf(TEXT("float cell = round(Cell * 255.0);\n")
+		TEXT("return (float2(fmod(cell, %d.0), floor(cell / %d.0)) + frac(Repeat)) / %d.0;"), atlasSize, atlasSize, atlasSize);
+	cellUV->Inputs.SetNum(2);
+	cellUV->Inputs[0].InputName = TEXT("Repeat");
+	cellUV->Inputs[0].Input.Connect(0, repeat);
+	cellUV->Inputs[1].InputName = TEXT("Cell");
+	// Outputs of the vertex color are RGB, R, G, B, A
+	cellUV->Inputs[1].Input.Connect(4, vertexColor);
+
+	// The frac jumps at every block, the derivatives are taken before it at the atlas scale
+	UMaterialExpressionTextureCoordinate* atlasUV = NewObject<UMaterialExpressionTextureCoordinate>(material);
+	atlasUV->UTiling = atlasUV->VTiling = 1.0f / atlasSize;
+	UMaterialExpressionDDX* ddx = NewObject<UMaterialExpressionDDX>(material);
+	ddx->Value.Connect(0, atlasUV);
+	UMaterialExpressionDDY* ddy = NewObject<UMaterialExpressionDDY>(material);
+	ddy->Value.Connect(0, atlasUV);
+
+	UMaterialExpressionTextureSample* sample = NewObject<UMaterialExpressionTextureSample>(material);
+	sample->Texture = atlas;
+	sample->SamplerType = SAMPLERTYPE_Color;
+	sample->Coordinates.Connect(0, cellUV);
+	sample->MipValueMode = TMVM_Derivative;
+	sample->CoordinatesDX.Connect(0, ddx);
+	sample->CoordinatesDY.Connect(0, ddy);
+
+	for (UMaterialExpression* expression : TArray<UMaterialExpression*>{ repeat, vertexColor, cellUV, atlasUV, ddx, ddy, sample })
+	{
+		expression->Material = material;
+		material->GetExpressionCollection().AddExpression(expression);
+	}
+
+	// Same output as the per face material, the color of the texture
+	material->GetEditorOnlyData()->BaseColor.Connect(0, sample);
+
+	material->PreEditChange(nullptr);
+	material->PostEditChange();
+
+	return material;
+#else
+	UE_LOG(LogTemp, Error, TEXT("The greedy material is built by the editor, packaged builds don't have it"));
+	return nullptr;
+#endif
+}
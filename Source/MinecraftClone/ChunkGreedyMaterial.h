@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UMaterialInterface;
+
+// The material of GREEDY chunks. Greedy quads store the tile repetition in UV0 and the atlas cell in the
+// vertex color alpha (see AChunk::ExpandMeshData), so it samples the TileTextures atlas at
+// (cell + frac(UV0)) / ATLAS_SIZE, with the derivatives of the unwrapped UVs so the mips don't jump at
+// the tile edges. It's built in code from the atlas texture the first time it's asked for, which needs
+// the editor to compile it, packaged builds don't have it and mesh PER_FACE.
+// Game thread only.
+class MINECRAFTCLONE_API FChunkGreedyMaterial
+{
+public:
+	// Null if it can't be built
+	static UMaterialInterface* Get();
+
+private:
+	static UMaterialInterface* mMaterial;
+	static bool bBuilt;
+
+	static UMaterialInterface* Build();
+};
@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkLightStorage.h"
+
+void FChunkLightStorage::Init(int32 sectionSide, int32 sectionCount, uint8 fill)
+{
+	mSectionSide = sectionSide; mSectionCount = sectionCount;
+
+	mSections.Reset();
+	mSections.SetNum(sectionCount);
+	for (FSection& section : mSections) section.Uniform = fill;
+}
+
+void FChunkLightStorage::Set(int i, int j, int k, uint8 light)
+{
+	FSection& section = mSections[i / mSectionSide];
+	if (section.Values.Num() == 0)
+	{
+		if (light == section.Uniform) return;
+
+		section.Values.Init(section.Uniform, mSectionSide * mSectionSide * mSectionSide);
+	}
+
+	section.Values[((i % mSectionSide) * mSectionSide + j) * mSectionSide + k] = light;
+}
+
+void FChunkLightStorage::SetSectionUniform(int32 section, uint8 light)
+{
+	mSections[section].Values.Empty();
+	mSections[section].Uniform = light;
+}
+
+SIZE_T FChunkLightStorage::GetAllocatedSize() const
+{
+	SIZE_T size = mSections.GetAllocatedSize();
+	for (const FSection& section : mSections) size += section.Values.GetAllocatedSize();
+
+	return size;
+}
+
+void FChunkLightStorage::Empty()
+{
+	mSections.Empty();
+	mSectionSide = 0; mSectionCount = 0;
+}
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Light level of every block of a chunk, sky light in the high 4 bits and block light in the low 4 bits
+// of a byte, addressed with the same i (height), j, k coordinates as FChunkBlockStorage. A section with
+// a single value, all sky above the ground or all dark deep below it, doesn't allocate anything until
+// one of its blocks gets a different value.
+class MINECRAFTCLONE_API FChunkLightStorage
+{
+public:
+	static const uint8 MaxLight = 15;
+
+	// Every section becomes uniform with the fill value
+	void Init(int32 sectionSide, int32 sectionCount, uint8 fill = 0);
+
+	FORCEINLINE uint8 Get(int i, int j, int k) const
+	{
+		const FSection& section = mSections[i / mSectionSide];
+		if (section.Values.Num() == 0) return section.Uniform;
+
+		return section.Values[((i % mSectionSide) * mSectionSide + j) * mSectionSide + k];
+	}
+
+	void Set(int i, int j, int k, uint8 light);
+
+	// Replaces the whole section with a single value
+	void SetSectionUniform(int32 section, uint8 light);
+
+	static FORCEINLINE uint8 Pack(uint8 sky, uint8 block) { return uint8(sky << 4) | block; }
+	static FORCEINLINE uint8 GetSky(uint8 light) { return light >> 4; }
+	static FORCEINLINE uint8 GetBlock(uint8 light) { return light & MaxLight; }
+
+	// What the mesh shows, the brightest of both
+	static FORCEINLINE uint8 GetBrightness(uint8 light) { return FMath::Max(GetSky(light), GetBlock(light)); }
+
+	int32 GetSectionSide() const { return mSectionSide; }
+	int32 GetSectionCount() const { return mSectionCount; }
+	bool IsEmpty() const { return mSections.Num() == 0; }
+
+	SIZE_T GetAllocatedSize() const;
+
+	void Empty();
+
+private:
+	struct FSection
+	{
+		// Empty while the section is uniform
+		TArray<uint8> Values;
+		uint8 Uniform = 0;
+	};
+
+	TArray<FSection> mSections;
+	int32 mSectionSide = 0;
+	int32 mSectionCount = 0;
+};
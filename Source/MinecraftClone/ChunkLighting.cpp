@@ -0,0 +1,393 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkLighting.h"
+#include "Chunk.h"
+#include "ChunkLightStorage.h"
+#include "ChunkStats.h"
+
+// The two halves of a FChunkLightStorage value
+static const int32 SKY = 0;
+static const int32 BLOCK = 1;
+
+static const uint8 MAX_LIGHT = FChunkLightStorage::MaxLight;
+
+// MeshData::Direction order, in (i, j, k) for a chunk and in world blocks (x along k, y along j, z along i)
+static const int32 OFFSETS[6][3] = { {1, 0, 0}, {-1, 0, 0}, {0, 0, -1}, {0, 0, 1}, {0, -1, 0}, {0, 1, 0} };
+static const FIntVector WORLD_OFFSETS[6] = { FIntVector(0, 0, 1), FIntVector(0, 0, -1), FIntVector(-1, 0, 0),
+	FIntVector(1, 0, 0), FIntVector(0, -1, 0), FIntVector(0, 1, 0) };
+
+static FORCEINLINE bool IsOpaque(BlockType blockType)
+{
+	return FBlockRegistry::IsOpaque(blockType);
+}
+
+static FORCEINLINE uint8 GetChannel(uint8 light, int32 channel)
+{
+	return channel == SKY ? FChunkLightStorage::GetSky(light) : FChunkLightStorage::GetBlock(light);
+}
+
+static FORCEINLINE uint8 SetChannel(uint8 light, int32 channel, uint8 level)
+{
+	return channel == SKY ? FChunkLightStorage::Pack(level, FChunkLightStorage::GetBlock(light)) :
+		FChunkLightStorage::Pack(FChunkLightStorage::GetSky(light), level);
+}
+
+// What the block next to one with this level gets in that direction, if it's not opaque. Blocks that
+// aren't transparent either (leaves) take a level more and stop full sky light from going straight down
+static FORCEINLINE uint8 GetSpread(uint8 level, int32 channel, int32 direction, BlockType target)
+{
+	if (!FBlockRegistry::IsTransparent(target)) return level > 1 ? level - 2 : 0;
+	if (channel == SKY && direction == MeshData::DOWN && level == MAX_LIGHT) return level;
+
+	return level > 0 ? level - 1 : 0;
+}
+
+uint8 FChunkLighting::GetEmission(BlockType blockType)
+{
+	return FBlockRegistry::GetEmission(blockType);
+}
+
+// Cells are (i, j, k)
+static void SpreadInChunk(const FChunkBlockStorage& blocks, FChunkLightStorage& light, TArray<FIntVector>& queue, int32 channel)
+{
+	int32 side = blocks.GetSectionSide(), height = side * blocks.GetSectionCount();
+
+	for (int32 q = 0; q < queue.Num(); q++)
+	{
+		FIntVector cell = queue[q];
+		uint8 level = GetChannel(light.Get(cell.X, cell.Y, cell.Z), channel);
+
+		for (int32 d = 0; d < 6; d++)
+		{
+			int32 i = cell.X + OFFSETS[d][0], j = cell.Y + OFFSETS[d][1], k = cell.Z + OFFSETS[d][2];
+			if (i < 0 || i >= height || j < 0 || j >= side || k < 0 || k >= side) continue;
+
+			BlockType blockType = blocks.Get(i, j, k);
+			if (IsOpaque(blockType)) continue;
+
+			uint8 spread = GetSpread(level, channel, d, blockType);
+			uint8 current = light.Get(i, j, k);
+			if (spread <= GetChannel(current, channel)) continue;
+
+			light.Set(i, j, k, SetChannel(current, channel, spread));
+			queue.Add(FIntVector(i, j, k));
+		}
+	}
+}
+
+void FChunkLighting::Compute(const FChunkBlockStorage& blocks, FChunkLightStorage& light)
+{
+	CHUNK_STAGE_SCOPE(STAT_ChunkLight, Light);
+
+	int32 side = blocks.GetSectionSide(), sectionCount = blocks.GetSectionCount();
+	light.Init(side, sectionCount, 0);
+	if (side == 0) return;
+
+	// The sections above the highest block are all sky and stay uniform
+	int32 topSection = sectionCount - 1;
+	while (topSection >= 0 && blocks.IsSectionEmpty(topSection)) topSection--;
+
+	uint8 sky = FChunkLightStorage::Pack(MAX_LIGHT, 0);
+	for (int32 section = topSection + 1; section < sectionCount; section++)
+		light.SetSectionUniform(section, sky);
+
+	// Then straight down every column until the first block that isn't transparent, tops is where the
+	// full sky light stops. A column stopped by leaves lights them with what comes through and goes on from there
+	TArray<FIntVector> queue;
+	TArray<int32> tops;
+	tops.SetNumUninitialized(side * side);
+	for (int32 j = 0; j < side; j++)
+	{
+		for (int32 k = 0; k < side; k++)
+		{
+			int32 i = (topSection + 1) * side - 1;
+			for (; i >= 0 && FBlockRegistry::IsTransparent(blocks.Get(i, j, k)); i--) light.Set(i, j, k, sky);
+
+			tops[j * side + k] = i + 1;
+
+			if (i >= 0 && !IsOpaque(blocks.Get(i, j, k)))
+			{
+				light.Set(i, j, k, FChunkLightStorage::Pack(GetSpread(MAX_LIGHT, SKY, MeshData::DOWN, blocks.Get(i, j, k)), 0));
+				queue.Add(FIntVector(i, j, k));
+			}
+		}
+	}
+
+	// Only the sky lit blocks next to a column that stops higher up have anything to light
+	for (int32 j = 0; j < side; j++)
+	{
+		for (int32 k = 0; k < side; k++)
+		{
+			int32 top = tops[j * side + k], neighborTop = top;
+			if (j > 0) neighborTop = FMath::Max(neighborTop, tops[(j - 1) * side + k]);
+			if (j + 1 < side) neighborTop = FMath::Max(neighborTop, tops[(j + 1) * side + k]);
+			if (k > 0) neighborTop = FMath::Max(neighborTop, tops[j * side + k - 1]);
+			if (k + 1 < side) neighborTop = FMath::Max(neighborTop, tops[j * side + k + 1]);
+
+			for (int32 i = top; i < neighborTop; i++) queue.Add(FIntVector(i, j, k));
+		}
+	}
+	SpreadInChunk(blocks, light, queue, SKY);
+
+	// Block light, skipped while nothing gives any off
+	if (!FBlockRegistry::HasEmitters()) return;
+
+	queue.Reset();
+	for (int32 i = 0; i < side * sectionCount; i++)
+	{
+		for (int32 j = 0; j < side; j++)
+		{
+			for (int32 k = 0; k < side; k++)
+			{
+				uint8 emission = GetEmission(blocks.Get(i, j, k));
+				if (emission == 0) continue;
+
+				light.Set(i, j, k, SetChannel(light.Get(i, j, k), BLOCK, emission));
+				queue.Add(FIntVector(i, j, k));
+			}
+		}
+	}
+	SpreadInChunk(blocks, light, queue, BLOCK);
+}
+
+// Positions are in world blocks, blocks of chunks that aren't loaded are outside of it and light doesn't
+// go there. Chunks that aren't in the AChunk::ChunkRegistry (ie. created from Blueprints) are on their own.
+// The chunk grid is in blocks of the origin's side, chunks of another size are seen as not loaded
+class FChunkLighting::FWorldLight
+{
+public:
+	explicit FWorldLight(AChunk* origin) :
+		mOrigin(origin),
+		mSide(origin->mSectionSide),
+		mHeight(origin->mSectionSide * origin->mSectionCount),
+		bRegistered(AChunk::FindChunk(origin->mChunkX, origin->mChunkY) == origin)
+	{
+	}
+
+	FIntVector GetPosition(const AChunk* chunk, int32 i, int32 j, int32 k) const
+	{
+		return FIntVector(chunk->mChunkX * mSide + k, chunk->mChunkY * mSide + j, i);
+	}
+
+	bool Find(const FIntVector& position, AChunk*& chunk, int32& i, int32& j, int32& k)
+	{
+		if (position.Z < 0 || position.Z >= mHeight) return false;
+
+		int32 chunkX = FMath::DivideAndRoundDown(position.X, mSide), chunkY = FMath::DivideAndRoundDown(position.Y, mSide);
+		chunk = GetChunk(chunkX, chunkY);
+		if (!chunk) return false;
+
+		i = position.Z; j = position.Y - chunkY * mSide; k = position.X - chunkX * mSide;
+		return j < chunk->mSectionSide && k < chunk->mSectionSide;
+	}
+
+	// Every face that samples the block is on a block next to it, diagonals included
+	void MarkChanged(const FIntVector& position)
+	{
+		int32 fromSection = FMath::Max(position.Z - 1, 0) / mSide;
+		int32 toSection = FMath::Min(position.Z + 1, mHeight - 1) / mSide;
+		uint32 sections = ((2u << toSection) - 1) & ~((1u << fromSection) - 1);
+
+		int32 fromX = FMath::DivideAndRoundDown(position.X - 1, mSide), toX = FMath::DivideAndRoundDown(position.X + 1, mSide);
+		int32 fromY = FMath::DivideAndRoundDown(position.Y - 1, mSide), toY = FMath::DivideAndRoundDown(position.Y + 1, mSide);
+		for (int32 chunkX = fromX; chunkX <= toX; chunkX++)
+		{
+			for (int32 chunkY = fromY; chunkY <= toY; chunkY++)
+			{
+				if (AChunk* chunk = GetChunk(chunkX, chunkY)) mDirtySections.FindOrAdd(chunk) |= sections;
+			}
+		}
+	}
+
+	void MarkSectionsDirty(bool urgent)
+	{
+		for (const TPair<AChunk*, uint32>& chunk : mDirtySections)
+		{
+			for (uint32 sections = chunk.Value; sections; sections &= sections - 1)
+				chunk.Key->MarkSectionDirty(FMath::CountTrailingZeros(sections), urgent);
+		}
+	}
+
+	// Takes out the light that came through the queued blocks, which already have their new level, and
+	// queues the blocks around that still have light of their own to spread it back
+	void Remove(TArray<TPair<FIntVector, uint8>>& queue, TArray<FIntVector>& spreadQueue, int32 channel)
+	{
+		for (int32 q = 0; q < queue.Num(); q++)
+		{
+			FIntVector position = queue[q].Key;
+			uint8 removed = queue[q].Value;
+
+			for (int32 d = 0; d < 6; d++)
+			{
+				FIntVector neighbor = position + WORLD_OFFSETS[d];
+				AChunk* chunk; int32 i, j, k;
+				if (!Find(neighbor, chunk, i, j, k)) continue;
+
+				uint8 current = chunk->mLight.Get(i, j, k);
+				uint8 level = GetChannel(current, channel);
+				if (level == 0) continue;
+
+				bool bLitFromHere = level < removed || (channel == SKY && d == MeshData::DOWN && removed == MAX_LIGHT && level == MAX_LIGHT &&
+					FBlockRegistry::IsTransparent(chunk->mBlocks.Get(i, j, k)));
+				if (!bLitFromHere)
+				{
+					spreadQueue.Add(neighbor);
+					continue;
+				}
+
+				uint8 emission = channel == BLOCK ? GetEmission(chunk->mBlocks.Get(i, j, k)) : 0;
+				chunk->mLight.Set(i, j, k, SetChannel(current, channel, emission));
+				MarkChanged(neighbor);
+
+				queue.Add(TPair<FIntVector, uint8>(neighbor, level));
+				if (emission > 0) spreadQueue.Add(neighbor);
+			}
+		}
+	}
+
+	void Spread(TArray<FIntVector>& queue, int32 channel)
+	{
+		for (int32 q = 0; q < queue.Num(); q++)
+		{
+			AChunk* chunk; int32 i, j, k;
+			if (!Find(queue[q], chunk, i, j, k)) continue;
+
+			uint8 level = GetChannel(chunk->mLight.Get(i, j, k), channel);
+			if (level == 0) continue;
+
+			for (int32 d = 0; d < 6; d++)
+			{
+				FIntVector neighbor = queue[q] + WORLD_OFFSETS[d];
+				if (!Find(neighbor, chunk, i, j, k)) continue;
+
+				BlockType blockType = chunk->mBlocks.Get(i, j, k);
+				if (IsOpaque(blockType)) continue;
+
+				uint8 spread = GetSpread(level, channel, d, blockType);
+				uint8 current = chunk->mLight.Get(i, j, k);
+				if (spread <= GetChannel(current, channel)) continue;
+
+				chunk->mLight.Set(i, j, k, SetChannel(current, channel, spread));
+				MarkChanged(neighbor);
+				queue.Add(neighbor);
+			}
+		}
+	}
+
+private:
+	AChunk* mOrigin;
+	int32 mSide;
+	int32 mHeight;
+	bool bRegistered;
+
+	// Most lookups hit the same chunk as the one before
+	AChunk* mLastChunk = nullptr;
+	int32 mLastX = MAX_int32;
+	int32 mLastY = MAX_int32;
+
+	TMap<AChunk*, uint32> mDirtySections;
+
+	AChunk* GetChunk(int32 chunkX, int32 chunkY)
+	{
+		if (chunkX == mLastX && chunkY == mLastY) return mLastChunk;
+
+		AChunk* chunk = nullptr;
+		if (chunkX == mOrigin->mChunkX && chunkY == mOrigin->mChunkY) chunk = mOrigin;
+		else if (bRegistered) chunk = AChunk::FindChunk(chunkX, chunkY);
+
+		// Chunks of another size or without light yet, a Blueprint chunk next to the world for example
+		if (chunk && (chunk->mLight.IsEmpty() || chunk->mSectionSide != mSide || chunk->mSectionSide * chunk->mSectionCount != mHeight)) chunk = nullptr;
+
+		mLastX = chunkX; mLastY = chunkY; mLastChunk = chunk;
+		return chunk;
+	}
+};
+
+void FChunkLighting::StitchNeighbors(AChunk* chunk)
+{
+	CHUNK_STAGE_SCOPE(STAT_ChunkRelight, Relight);
+
+	if (chunk->mLight.IsEmpty()) return;
+
+	FWorldLight world(chunk);
+	int32 side = chunk->mSectionSide, height = side * chunk->mSectionCount;
+
+	// Both chunks were lit as if the other one was dark, so light only has to be added, from the side of
+	// the wall that's brighter than the other one can explain
+	TArray<FIntVector> queues[2];
+	for (int32 d = MeshData::LEFT; d <= MeshData::BACK; d++)
+	{
+		AChunk* neighbor = AChunk::FindChunk(chunk->mChunkX + WORLD_OFFSETS[d].X, chunk->mChunkY + WORLD_OFFSETS[d].Y);
+		if (!neighbor || neighbor->mLight.IsEmpty() || neighbor->mSectionSide != side || neighbor->mSectionCount != chunk->mSectionCount) continue;
+
+		for (int32 i = 0; i < height; i++)
+		{
+			for (int32 along = 0; along < side; along++)
+			{
+				int32 j = along, k = along, neighborJ = along, neighborK = along;
+				if (d == MeshData::LEFT) { k = 0; neighborK = side - 1; }
+				else if (d == MeshData::RIGHT) { k = side - 1; neighborK = 0; }
+				else if (d == MeshData::FORWARD) { j = 0; neighborJ = side - 1; }
+				else { j = side - 1; neighborJ = 0; }
+
+				if (IsOpaque(chunk->mBlocks.Get(i, j, k)) || IsOpaque(neighbor->mBlocks.Get(i, neighborJ, neighborK))) continue;
+
+				uint8 light = chunk->mLight.Get(i, j, k), neighborLight = neighbor->mLight.Get(i, neighborJ, neighborK);
+				for (int32 channel = SKY; channel <= BLOCK; channel++)
+				{
+					uint8 level = GetChannel(light, channel), neighborLevel = GetChannel(neighborLight, channel);
+					if (level > neighborLevel + 1) queues[channel].Add(world.GetPosition(chunk, i, j, k));
+					else if (neighborLevel > level + 1) queues[channel].Add(world.GetPosition(neighbor, i, neighborJ, neighborK));
+				}
+			}
+		}
+	}
+
+	world.Spread(queues[SKY], SKY);
+	world.Spread(queues[BLOCK], BLOCK);
+	world.MarkSectionsDirty(false);
+}
+
+void FChunkLighting::UpdateBlock(AChunk* chunk, int32 i, int32 j, int32 k)
+{
+	CHUNK_STAGE_SCOPE(STAT_ChunkRelight, Relight);
+
+	if (chunk->mLight.IsEmpty()) return;
+
+	FWorldLight world(chunk);
+	FIntVector position = world.GetPosition(chunk, i, j, k);
+	BlockType blockType = chunk->mBlocks.Get(i, j, k);
+	bool bOpaque = IsOpaque(blockType);
+
+	for (int32 channel = SKY; channel <= BLOCK; channel++)
+	{
+		uint8 current = chunk->mLight.Get(i, j, k);
+		uint8 previous = GetChannel(current, channel);
+
+		// An open block at the top of the world sees the sky
+		uint8 own = channel == BLOCK ? GetEmission(blockType) : 0;
+		if (channel == SKY && !bOpaque && i == chunk->mSectionSide * chunk->mSectionCount - 1) own = GetSpread(MAX_LIGHT, SKY, MeshData::DOWN, blockType);
+
+		if (own != previous)
+		{
+			chunk->mLight.Set(i, j, k, SetChannel(current, channel, own));
+			world.MarkChanged(position);
+		}
+
+		TArray<TPair<FIntVector, uint8>> removeQueue;
+		TArray<FIntVector> spreadQueue;
+		if (previous > own) removeQueue.Add(TPair<FIntVector, uint8>(position, previous));
+		if (own > 0) spreadQueue.Add(position);
+
+		// The light around comes in through an open block
+		if (!bOpaque)
+		{
+			for (int32 d = 0; d < 6; d++) spreadQueue.Add(position + WORLD_OFFSETS[d]);
+		}
+
+		world.Remove(removeQueue, spreadQueue, channel);
+		world.Spread(spreadQueue, channel);
+	}
+
+	world.MarkSectionsDirty(true);
+}
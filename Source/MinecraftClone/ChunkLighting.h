@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AChunk;
+class FChunkBlockStorage;
+class FChunkLightStorage;
+enum class BlockType : uint8;
+
+// Sky light and block light, spread with a BFS like Minecraft does. Sky light comes down from the top of
+// the world without getting weaker and loses a level per block in every other direction, block light
+// loses a level per block from the block that gives it off. Opaque blocks stop both, blocks that aren't
+// transparent either (leaves) let them through a level weaker than air does.
+// Chunks are lit on their own when they're built, AChunk::PlaceChunk spreads the light across the walls
+// with the loaded neighbors, and block edits only relight what they change, with a removal queue and a
+// spread queue that cross chunk walls too. Sections whose faces see a changed light are remeshed.
+class MINECRAFTCLONE_API FChunkLighting
+{
+public:
+	// Light the block gives off, see FBlockRegistry
+	static uint8 GetEmission(BlockType blockType);
+
+	// Lights the blocks of a chunk that isn't placed yet, the neighbors are seen as dark. Thread safe
+	static void Compute(const FChunkBlockStorage& blocks, FChunkLightStorage& light);
+
+	// Spreads the light between a chunk that was just placed and its loaded neighbors. Game thread
+	static void StitchNeighbors(AChunk* chunk);
+
+	// Relights around the block at i, j, k of the chunk after it was replaced. Game thread
+	static void UpdateBlock(AChunk* chunk, int32 i, int32 j, int32 k);
+
+private:
+	// Light of the loaded chunks by world block position, see the cpp
+	class FWorldLight;
+};
@@ -0,0 +1,281 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkLoadScheduler.h"
+#include "ChunkStats.h"
+#include "ChunkLighting.h"
+
+// Same order as the LEFT, RIGHT, FORWARD and BACK walls of FChunkBorders
+static const int32 NEIGHBOR_OFFSETS[4][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+
+FChunkLoadScheduler::~FChunkLoadScheduler()
+{
+	CancelAll();
+}
+
+void FChunkLoadScheduler::SetCenter(int32 ChunkX, int32 ChunkY, FVector2D viewDirection, int32 renderDistance)
+{
+	mCenterX = ChunkX; mCenterY = ChunkY;
+	mRenderDistance = renderDistance;
+	mViewDirection = viewDirection.GetSafeNormal();
+
+	// Drop the requests that fell out of range and re-prioritize the rest
+	for (int32 r = mPending.Num() - 1; r >= 0; r--)
+	{
+		FChunkRequest& request = mPending[r];
+		if (!IsInRange(request.ChunkX, request.ChunkY))
+		{
+			AChunk::ChunkRegistry.SetState(request.ChunkX, request.ChunkY, EChunkState::None);
+			mPendingKeys.Remove(GetKey(request.ChunkX, request.ChunkY));
+			mPending.RemoveAtSwap(r);
+			continue;
+		}
+
+		request.Priority = GetPriority(request.ChunkX, request.ChunkY);
+	}
+	mPending.Heapify(FPriorityLess());
+
+	// Cancelled jobs still count against the limits until their tasks are done
+	for (TPair<int64, FChunkJobPtr>& job : mInFlight)
+	{
+		if (!IsInRange(job.Value->ChunkX, job.Value->ChunkY) && !job.Value->bCancelled)
+		{
+			AChunk::ChunkRegistry.SetState(job.Value->ChunkX, job.Value->ChunkY, EChunkState::None);
+			job.Value->bCancelled = true;
+		}
+	}
+}
+
+void FChunkLoadScheduler::Request(int32 ChunkX, int32 ChunkY)
+{
+	int64 key = GetKey(ChunkX, ChunkY);
+	if (mPendingKeys.Contains(key)) return;
+
+	// A cancelled job can be requested again, it just gets replaced once it's done
+	FChunkJobPtr* job = mInFlight.Find(key);
+	if (job && !(*job)->bCancelled) return;
+
+	mPendingKeys.Add(key);
+	AChunk::ChunkRegistry.SetState(ChunkX, ChunkY, EChunkState::Requested);
+	mPending.HeapPush(FChunkRequest{ ChunkX, ChunkY, GetPriority(ChunkX, ChunkY), FPlatformTime::Seconds() }, FPriorityLess());
+}
+
+bool FChunkLoadScheduler::IsRequested(int32 ChunkX, int32 ChunkY) const
+{
+	int64 key = GetKey(ChunkX, ChunkY);
+	const FChunkJobPtr* job = mInFlight.Find(key);
+
+	return mPendingKeys.Contains(key) || (job && !(*job)->bCancelled);
+}
+
+void FChunkLoadScheduler::Tick(TQueue<TUniquePtr<FChunkBuildResult>>& chunkLoaderQueue)
+{
+	CHUNK_STAGE_SCOPE(STAT_ChunkEnqueue, Enqueue);
+
+	int32 generating = 0, meshing = 0;
+	TArray<FChunkJobPtr> readyToMesh;
+	for (TMap<int64, FChunkJobPtr>::TIterator job = mInFlight.CreateIterator(); job; ++job)
+	{
+		FChunkJob& current = *job.Value();
+
+		// Cancelled jobs still count against the limits until their tasks are done, the results are freed with the job
+		if (current.IsBuildingBlocks()) generating++;
+		else if (current.IsMeshing()) meshing++;
+		else if (current.bCancelled) job.RemoveCurrent();
+		else if (!current.bMeshStarted) readyToMesh.Add(job.Value());
+		else
+		{
+			if (current.Result)
+			{
+				AChunk::ChunkRegistry.SetState(current.ChunkX, current.ChunkY, EChunkState::Meshed);
+				chunkLoaderQueue.Enqueue(MoveTemp(current.Result));
+			}
+			job.RemoveCurrent();
+		}
+	}
+
+	// Closest first, a chunk waits for the neighbors that are still pending so the mesh doesn't miss them,
+	// the ones that aren't requested at all are missing and get remeshed if they show up later
+	readyToMesh.Sort([this](const FChunkJobPtr& A, const FChunkJobPtr& B)
+	{
+		return GetPriority(A->ChunkX, A->ChunkY) < GetPriority(B->ChunkX, B->ChunkY);
+	});
+
+	for (const FChunkJobPtr& job : readyToMesh)
+	{
+		if (meshing >= MaxMeshJobs) break;
+
+		bool bNeighborPending = false;
+		for (int32 n = 0; n < 4 && !bNeighborPending; n++)
+			bNeighborPending = mPendingKeys.Contains(GetKey(job->ChunkX + NEIGHBOR_OFFSETS[n][0], job->ChunkY + NEIGHBOR_OFFSETS[n][1]));
+		if (bNeighborPending) continue;
+
+		StartMesh(job);
+		meshing++;
+	}
+
+	// Requests still waiting on a cancelled job for the same chunk are retried next tick
+	TArray<FChunkRequest> deferred;
+	while (generating < MaxGenerateJobs && mPending.Num() > 0)
+	{
+		FChunkRequest request;
+		mPending.HeapPop(request, FPriorityLess());
+
+		if (mInFlight.Contains(GetKey(request.ChunkX, request.ChunkY)))
+		{
+			deferred.Add(request);
+			continue;
+		}
+
+		mPendingKeys.Remove(GetKey(request.ChunkX, request.ChunkY));
+		StartJob(request);
+		generating++;
+	}
+
+	for (const FChunkRequest& request : deferred)
+		mPending.HeapPush(request, FPriorityLess());
+}
+
+void FChunkLoadScheduler::CancelAll()
+{
+	for (const FChunkRequest& request : mPending)
+		AChunk::ChunkRegistry.SetState(request.ChunkX, request.ChunkY, EChunkState::None);
+	mPending.Empty();
+	mPendingKeys.Empty();
+
+	// The tasks read the block registry and save into the RegionStore, which are torn down after this, so
+	// they're waited for. Cancelled tasks return right away, only the ones already running take a while
+	TArray<UE::Tasks::FTask> tasks;
+	for (TPair<int64, FChunkJobPtr>& job : mInFlight)
+	{
+		if (!job.Value->bCancelled) AChunk::ChunkRegistry.SetState(job.Value->ChunkX, job.Value->ChunkY, EChunkState::None);
+		job.Value->bCancelled = true;
+
+		// The Light task waits for the Generate and Decorate ones
+		if (job.Value->BlocksTask.IsValid()) tasks.Add(job.Value->BlocksTask);
+		if (job.Value->bMeshStarted) tasks.Add(job.Value->MeshTask);
+	}
+	UE::Tasks::Wait(tasks);
+	mInFlight.Empty();
+}
+
+// Distance in chunks, chunks in front of the camera count as up to ViewDirectionWeight closer
+float FChunkLoadScheduler::GetPriority(int32 ChunkX, int32 ChunkY) const
+{
+	FVector2D offset = FVector2D(ChunkX - mCenterX, ChunkY - mCenterY);
+	double distance = offset.Size();
+	if (distance == 0.0) return 0.0f;
+
+	return float(distance - ViewDirectionWeight * FVector2D::DotProduct(offset / distance, mViewDirection));
+}
+
+bool FChunkLoadScheduler::IsInRange(int32 ChunkX, int32 ChunkY) const
+{
+	return FMath::Abs(ChunkX - mCenterX) <= mRenderDistance && FMath::Abs(ChunkY - mCenterY) <= mRenderDistance;
+}
+
+void FChunkLoadScheduler::StartJob(const FChunkRequest& request)
+{
+	FChunkJobPtr job = MakeShared<FChunkJob, ESPMode::ThreadSafe>();
+	job->ChunkX = request.ChunkX; job->ChunkY = request.ChunkY;
+	job->RequestSeconds = request.RequestSeconds;
+	mInFlight.Add(GetKey(request.ChunkX, request.ChunkY), job);
+	AChunk::ChunkRegistry.SetState(request.ChunkX, request.ChunkY, EChunkState::Generating);
+
+	// Generators that aren't thread safe generate and decorate here, loading is still faster than the generator,
+	// so it's done here too
+	UE::Tasks::FTask generateTask;
+	bool bGameThread = !Generator->IsThreadSafe();
+	if (bGameThread)
+	{
+		job->bLoaded = RegionStore && RegionStore->Load(job->ChunkX, job->ChunkY, job->Blocks);
+		if (!job->bLoaded)
+		{
+			int32 dummy;
+			job->Blocks = AChunk::GenerateChunkData(job->ChunkX, job->ChunkY, 16, 16, dummy, dummy, *Generator);
+			Generator->Decorate(job->ChunkX, job->ChunkY, job->Blocks);
+		}
+	}
+	else
+	{
+		generateTask = UE::Tasks::Launch(TEXT("ChunkGenerate"), [job, generator = Generator, regionStore = RegionStore]()
+		{
+			if (job->bCancelled) return;
+
+			job->bLoaded = regionStore && regionStore->Load(job->ChunkX, job->ChunkY, job->Blocks);
+			if (!job->bLoaded)
+			{
+				int32 dummy;
+				job->Blocks = AChunk::GenerateChunkData(job->ChunkX, job->ChunkY, 16, 16, dummy, dummy, *generator);
+			}
+		}, UE::Tasks::ETaskPriority::BackgroundNormal);
+	}
+
+	TFunction<void()> DecorateTask = [job, generator = Generator, regionStore = RegionStore,
+		saveBlocks = RegionStore && SaveGeneratedChunks, bDecorated = bGameThread]()
+	{
+		if (job->bCancelled) return;
+
+		if (!job->bLoaded)
+		{
+			if (!bDecorated)
+			{
+				CHUNK_STAGE_SCOPE(STAT_ChunkDecorate, Decorate);
+				generator->Decorate(job->ChunkX, job->ChunkY, job->Blocks);
+			}
+
+			// Queued right away, so they're loaded next time. A copy, the job still needs its blocks
+			if (saveBlocks) regionStore->SaveAsync(job->ChunkX, job->ChunkY, FChunkBlockStorage(job->Blocks), false);
+		}
+	};
+
+	UE::Tasks::FTask decorateTask = generateTask.IsValid() ?
+		UE::Tasks::Launch(TEXT("ChunkDecorate"), MoveTemp(DecorateTask), UE::Tasks::Prerequisites(generateTask), UE::Tasks::ETaskPriority::BackgroundNormal) :
+		UE::Tasks::Launch(TEXT("ChunkDecorate"), MoveTemp(DecorateTask), UE::Tasks::ETaskPriority::BackgroundNormal);
+
+	// The neighbors mesh against the light of the walls too, so it has to be there before the walls are taken
+	job->BlocksTask = UE::Tasks::Launch(TEXT("ChunkLight"), [job]()
+	{
+		if (job->bCancelled) return;
+
+		FChunkLighting::Compute(job->Blocks, job->Light);
+		job->Walls = FChunkBorders::GetWalls(job->Blocks, &job->Light);
+	}, UE::Tasks::Prerequisites(decorateTask), UE::Tasks::ETaskPriority::BackgroundNormal);
+}
+
+void FChunkLoadScheduler::StartMesh(const FChunkJobPtr& job)
+{
+	job->bMeshStarted = true;
+
+	// Neighbors that are loaded right now are copied here, the ones being built are read by the task once
+	// their blocks are done. CreateChunk fixes up the ones that arrive later
+	FChunkBorders borders = AChunk::GetChunkBorders(job->ChunkX, job->ChunkY);
+	TStaticArray<FChunkJobPtr, 4> neighborJobs;
+	TArray<UE::Tasks::FTask, TInlineAllocator<4>> prerequisites;
+	for (int32 n = 0; n < 4; n++)
+	{
+		FChunkJobPtr* neighbor = mInFlight.Find(GetKey(job->ChunkX + NEIGHBOR_OFFSETS[n][0], job->ChunkY + NEIGHBOR_OFFSETS[n][1]));
+		if (!neighbor || (*neighbor)->bCancelled) continue;
+
+		neighborJobs[n] = *neighbor;
+		if ((*neighbor)->IsBuildingBlocks()) prerequisites.Add((*neighbor)->BlocksTask);
+	}
+
+	// Far chunks are meshed at a LOD right away, AChunk::UpdateLod fixes it if the player moved meanwhile
+	int32 lod = AChunk::GetLodForDistance(FMath::Max(FMath::Abs(job->ChunkX - mCenterX), FMath::Abs(job->ChunkY - mCenterY)));
+
+	job->MeshTask = UE::Tasks::Launch(TEXT("ChunkMesh"), [job, neighborJobs, borders = MoveTemp(borders),
+		meshingMode = meshingMode, lod]() mutable
+	{
+		if (job->bCancelled) return;
+
+		// A neighbor cancelled before its blocks were made has no walls
+		for (int32 n = 0; n < 4; n++)
+		{
+			if (neighborJobs[n] && neighborJobs[n]->Walls.loadedMask)
+				borders.SetNeighbor(MeshData::Direction(MeshData::LEFT + n), neighborJobs[n]->Walls);
+		}
+
+		job->Result = AChunk::BuildChunk(job->ChunkX, job->ChunkY, MoveTemp(job->Blocks), meshingMode, &borders, lod, MoveTemp(job->Light));
+		job->Result->requestSeconds = job->RequestSeconds;
+	}, prerequisites, UE::Tasks::ETaskPriority::BackgroundNormal);
+}
@@ -0,0 +1,139 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "Containers/StaticArray.h"
+#include "Tasks/Task.h"
+#include "Chunk.h"
+#include "TerrainGenerator.h"
+#include "ChunkRegionStore.h"
+#include <atomic>
+
+// Decides which chunks get built and in which order. Requests are kept in a heap ordered by distance
+// to the player, slightly favoring the ones in front of the camera, and jobs that fall out of range
+// are cancelled. Each job is a chain of tasks on the task graph, one per stage:
+//   Generate: loads the blocks from the RegionStore, or fills them with the Generator
+//   Decorate: IChunkGenerator::Decorate
+//   Light:    lights the chunk on its own with FChunkLighting, then takes the walls and their light
+//             the neighbors mesh against
+//   Mesh:     meshes the sections once the blocks of the neighbors being built exist, so the chunk
+//             walls are culled against them right away instead of remeshed when they show up
+// The task graph spreads the tasks over every worker and steals work between them, the scheduler
+// only limits how many jobs of each stage are in flight. Remeshing goes through the same
+// AChunk::BuildChunk as the Mesh stage without going back through the others, see FChunkRemeshQueue.
+// Everything but the tasks runs on the game thread. The chunks go through the Requested
+// and Generating states of the AChunk::ChunkRegistry here, dropped ones leave it.
+class MINECRAFTCLONE_API FChunkLoadScheduler
+{
+public:
+	~FChunkLoadScheduler();
+
+	// Generators that aren't thread safe run on the game thread when the job starts, only meshing goes to the pool
+	TSharedPtr<const IChunkGenerator, ESPMode::ThreadSafe> Generator;
+
+	// Chunks found here are loaded instead of generated, optional
+	TSharedPtr<FChunkRegionStore, ESPMode::ThreadSafe> RegionStore;
+
+	// Generated chunks are queued to the RegionStore right away by the job, so they're loaded next time
+	bool SaveGeneratedChunks = true;
+
+	MeshingMode meshingMode = MeshingMode::PER_FACE;
+
+	// Jobs in the Generate, Decorate and Light stages at once
+	int32 MaxGenerateJobs = 8;
+
+	// Jobs in the Mesh stage at once. Chunks whose neighbors are still pending wait outside of it and
+	// don't count, so they can't hold the slots of chunks that are ready
+	int32 MaxMeshJobs = 8;
+
+	// How many chunks of distance a chunk right in front of the camera is worth
+	float ViewDirectionWeight = 1.0f;
+
+	// Re-prioritizes the pending requests around the new center and drops or cancels
+	// everything further than renderDistance (in chunks, on either axis)
+	void SetCenter(int32 ChunkX, int32 ChunkY, FVector2D viewDirection, int32 renderDistance);
+
+	// Ignored if the chunk is already pending or being generated
+	void Request(int32 ChunkX, int32 ChunkY);
+
+	bool IsRequested(int32 ChunkX, int32 ChunkY) const;
+
+	// Moves the finished chunks to chunkLoaderQueue and starts the stages that are ready, up to the limits
+	void Tick(TQueue<TUniquePtr<FChunkBuildResult>>& chunkLoaderQueue);
+
+	// Drops every request and job, and waits for the tasks that are running
+	void CancelAll();
+
+	int32 GetPendingCount() const { return mPending.Num(); }
+	int32 GetInFlightCount() const { return mInFlight.Num(); }
+
+private:
+	struct FChunkRequest
+	{
+		int32 ChunkX;
+		int32 ChunkY;
+		float Priority;
+		double RequestSeconds;
+	};
+
+	struct FPriorityLess
+	{
+		bool operator()(const FChunkRequest& A, const FChunkRequest& B) const { return A.Priority < B.Priority; }
+	};
+
+	struct FChunkJob
+	{
+		int32 ChunkX;
+		int32 ChunkY;
+		double RequestSeconds;
+		std::atomic<bool> bCancelled { false };
+
+		// Written by the Generate and Decorate tasks, moved into the Result by the Mesh task
+		FChunkBlockStorage Blocks;
+		bool bLoaded = false;
+
+		// Written by the Light task, moved into the Result by the Mesh task
+		FChunkLightStorage Light;
+
+		// The walls of Blocks and Light, final once BlocksTask is done, read by the Mesh tasks of the neighbors
+		FChunkBorders Walls;
+
+		// The Light task, done once Blocks, Light and Walls are final
+		UE::Tasks::FTask BlocksTask;
+		UE::Tasks::FTask MeshTask;
+		bool bMeshStarted = false;
+
+		TUniquePtr<FChunkBuildResult> Result;
+
+		bool IsBuildingBlocks() const { return !BlocksTask.IsCompleted(); }
+		bool IsMeshing() const { return bMeshStarted && !MeshTask.IsCompleted(); }
+	};
+
+	typedef TSharedPtr<FChunkJob, ESPMode::ThreadSafe> FChunkJobPtr;
+
+	// Min-heap on Priority
+	TArray<FChunkRequest> mPending;
+	TSet<int64> mPendingKeys;
+
+	// From the start of the Generate stage until the Mesh stage is done, cancelled jobs stay until their tasks are
+	TMap<int64, FChunkJobPtr> mInFlight;
+
+	int32 mCenterX = 0;
+	int32 mCenterY = 0;
+	int32 mRenderDistance = 0;
+	FVector2D mViewDirection = FVector2D::ZeroVector;
+
+	float GetPriority(int32 ChunkX, int32 ChunkY) const;
+
+	bool IsInRange(int32 ChunkX, int32 ChunkY) const;
+
+	// Launches the Generate, Decorate and Light tasks
+	void StartJob(const FChunkRequest& request);
+
+	// Launches the Mesh task, after the blocks of the chunk and the neighbors being built
+	void StartMesh(const FChunkJobPtr& job);
+
+	static int64 GetKey(int32 ChunkX, int32 ChunkY) { return FChunkRegistry::GetKey(ChunkX, ChunkY); }
+};
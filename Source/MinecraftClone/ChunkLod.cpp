@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkLod.h"
+
+FChunkBlockStorage FChunkLod::Downsample(const FChunkBlockStorage& blocks, int32 lod)
+{
+	int32 scale = 1 << lod;
+	int32 sectionSide = blocks.GetSectionSide(), cellSide = sectionSide / scale;
+
+	FChunkBlockStorage cells(cellSide, blocks.GetSectionCount(), BlockType::AIR);
+
+	TArray<BlockType> sectionBlocks, sectionCells;
+	sectionBlocks.SetNumUninitialized(sectionSide * sectionSide * sectionSide);
+	sectionCells.SetNumUninitialized(cellSide * cellSide * cellSide);
+
+	for (int32 section = 0; section < blocks.GetSectionCount(); section++)
+	{
+		if (blocks.IsSectionEmpty(section)) continue;
+
+		BlockType uniform;
+		if (blocks.IsSectionUniform(section, uniform))
+		{
+			for (BlockType& cell : sectionCells) cell = uniform;
+			cells.SetSection(section, sectionCells.GetData());
+			continue;
+		}
+
+		blocks.GetSection(section, sectionBlocks.GetData());
+
+		int32 c = 0;
+		for (int32 ci = 0; ci < cellSide; ci++)
+		{
+			for (int32 cj = 0; cj < cellSide; cj++)
+			{
+				for (int32 ck = 0; ck < cellSide; ck++, c++)
+				{
+					// From the top layer of the cell down, so the first solid block is the highest one
+					int32 solid = 0;
+					BlockType top = BlockType::AIR;
+					for (int32 di = scale - 1; di >= 0; di--)
+					{
+						for (int32 dj = 0; dj < scale; dj++)
+						{
+							const BlockType* row = sectionBlocks.GetData() + ((ci * scale + di) * sectionSide + cj * scale + dj) * sectionSide + ck * scale;
+							for (int32 dk = 0; dk < scale; dk++)
+							{
+								if (row[dk] == BlockType::AIR) continue;
+								if (top == BlockType::AIR) top = row[dk];
+								solid++;
+							}
+						}
+					}
+
+					sectionCells[c] = solid * 2 >= scale * scale * scale ? top : BlockType::AIR;
+				}
+			}
+		}
+
+		cells.SetSection(section, sectionCells.GetData());
+	}
+
+	return cells;
+}
+
+FChunkBorders FChunkLod::DownsampleBorders(const FChunkBorders& borders, int32 sectionSide, int32 lod)
+{
+	int32 scale = 1 << lod;
+	int32 cellSide = sectionSide / scale;
+
+	FChunkBorders cells;
+	cells.loadedMask = borders.loadedMask;
+
+	for (int32 wall = 0; wall < 4; wall++)
+	{
+		const TArray<BlockType>& slice = borders.slices[wall];
+		if (slice.Num() == 0) continue;
+
+		int32 height = slice.Num() / sectionSide, cellHeight = height / scale;
+		TArray<BlockType>& cellSlice = cells.slices[wall];
+		cellSlice.SetNumUninitialized(cellHeight * cellSide);
+
+		// Cleared below for every section with a cell that isn't opaque
+		cells.opaqueSections[wall] = (cellHeight / cellSide) >= 32 ? ~0u : (1u << (cellHeight / cellSide)) - 1;
+
+		for (int32 ci = 0; ci < cellHeight; ci++)
+		{
+			for (int32 calong = 0; calong < cellSide; calong++)
+			{
+				int32 solid = 0;
+				BlockType top = BlockType::AIR;
+				for (int32 di = scale - 1; di >= 0; di--)
+				{
+					const BlockType* row = slice.GetData() + (ci * scale + di) * sectionSide + calong * scale;
+					for (int32 dalong = 0; dalong < scale; dalong++)
+					{
+						if (row[dalong] == BlockType::AIR) continue;
+						if (top == BlockType::AIR) top = row[dalong];
+						solid++;
+					}
+				}
+
+				BlockType cell = solid * 2 >= scale * scale ? top : BlockType::AIR;
+				cellSlice[ci * cellSide + calong] = cell;
+				if (!FBlockRegistry::IsOpaque(cell)) cells.opaqueSections[wall] &= ~(1u << (ci / cellSide));
+			}
+		}
+	}
+
+	return cells;
+}
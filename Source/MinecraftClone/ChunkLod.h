@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Chunk.h"
+
+// Downsampled copies of the blocks of a chunk, meshed instead of the blocks for distant chunks.
+// LOD n merges 2^n x 2^n x 2^n blocks into one cell, the result is a regular FChunkBlockStorage with
+// the same section count and sections of sectionSide / 2^n cells, so the mesher works on it as is and
+// MeshData::lodScale scales the quads back up. A cell is solid if at least half of its blocks are,
+// and takes the highest solid block in it, so the surface keeps the GRASS on top.
+class MINECRAFTCLONE_API FChunkLod
+{
+public:
+	// 8x8x8 blocks per cell, sections of 16 blocks are 2 cells wide
+	static const int32 MaxLod = 3;
+
+	static FChunkBlockStorage Downsample(const FChunkBlockStorage& blocks, int32 lod);
+
+	// The neighbor walls for the downsampled blocks, sectionSide is the one of the full blocks.
+	// Only the outer block of the neighbor is known, so a wall cell is solid if half of its slice is
+	static FChunkBorders DownsampleBorders(const FChunkBorders& borders, int32 sectionSide, int32 lod);
+};
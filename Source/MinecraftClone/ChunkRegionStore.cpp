@@ -0,0 +1,431 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkRegionStore.h"
+#include "Async/Async.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Compression.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Chunk.h"
+#include "TerrainGenerator.h"
+#include "ChunkStats.h"
+
+// Region coordinates round down, so chunk -1 is in region -1 and not 0
+static int32 GetRegionCoordinate(int32 chunkCoordinate)
+{
+	return chunkCoordinate >= 0 ? chunkCoordinate / FChunkRegionStore::RegionSide :
+		(chunkCoordinate + 1) / FChunkRegionStore::RegionSide - 1;
+}
+
+FChunkRegionStore::FRegion::~FRegion()
+{
+	// The region goes before the file it maps
+	MappedRegion.Reset();
+	MappedFile.Reset();
+}
+
+FChunkRegionStore::FChunkRegionStore(const FString& directory) :
+	mDirectory(directory)
+{
+	FPlatformFileManager::Get().GetPlatformFile().CreateDirectoryTree(*mDirectory);
+}
+
+FChunkRegionStore::~FChunkRegionStore()
+{
+	Flush();
+}
+
+bool FChunkRegionStore::Load(int32 ChunkX, int32 ChunkY, FChunkBlockStorage& blocks)
+{
+	CHUNK_STAGE_SCOPE(STAT_ChunkLoad, Load);
+
+	// Not on disk yet, copy the blocks waiting to be written
+	{
+		FScopeLock lock(&mPendingLock);
+		if (FBlocksPtr* pending = mPendingSaves.Find(GetKey(ChunkX, ChunkY)))
+		{
+			blocks = **pending;
+			return true;
+		}
+	}
+
+	FRegionPtr region = GetRegion(ChunkX, ChunkY);
+	int32 entryIndex = GetEntryIndex(ChunkX, ChunkY);
+
+	TArray<uint8> uncompressed;
+	for (;;)
+	{
+		{
+			FReadScopeLock lock(region->Lock);
+
+			const FRegionEntry& entry = region->Entries[entryIndex];
+			if (entry.Size == 0) return false;
+
+			if (region->MappedRegion)
+			{
+				// A table pointing past the end of the file, or at more than a chunk can be, is a corrupted file
+				if (int64(entry.Offset) + entry.Size > region->MappedRegion->GetMappedSize()) return false;
+				if (entry.UncompressedSize > uint32(FChunkBlockStorage::MaxSerializedSize)) return false;
+
+				uncompressed.SetNumUninitialized(entry.UncompressedSize);
+				if (!FCompression::UncompressMemory(NAME_Oodle, uncompressed.GetData(), entry.UncompressedSize,
+					region->MappedRegion->GetMappedPtr() + entry.Offset, entry.Size))
+				{
+					return false;
+				}
+				break;
+			}
+		}
+
+		// Mapped on the first load, writes map it again themselves unless that failed. A write can drop
+		// it again before the read lock is back so this loops
+		FWriteScopeLock lock(region->Lock);
+		if (!region->MappedRegion && !MapRegion(*region)) return false;
+	}
+
+	FMemoryReader reader(uncompressed);
+	blocks.Serialize(reader);
+	return !reader.IsError();
+}
+
+bool FChunkRegionStore::Contains(int32 ChunkX, int32 ChunkY)
+{
+	{
+		FScopeLock lock(&mPendingLock);
+		if (mPendingSaves.Contains(GetKey(ChunkX, ChunkY))) return true;
+	}
+
+	FRegionPtr region = GetRegion(ChunkX, ChunkY);
+
+	FReadScopeLock lock(region->Lock);
+	return region->Entries[GetEntryIndex(ChunkX, ChunkY)].Size > 0;
+}
+
+bool FChunkRegionStore::Save(int32 ChunkX, int32 ChunkY, const FChunkBlockStorage& blocks, bool bOverwrite)
+{
+	if (!bOverwrite && Contains(ChunkX, ChunkY)) return true;
+
+	FCompressedChunk chunk;
+	chunk.EntryIndex = GetEntryIndex(ChunkX, ChunkY);
+	if (!Compress(blocks, chunk)) return false;
+
+	FRegionPtr region = GetRegion(ChunkX, ChunkY);
+
+	FWriteScopeLock lock(region->Lock);
+	if (!bOverwrite)
+	{
+		if (region->Entries[chunk.EntryIndex].Size > 0) return true;
+
+		FScopeLock pendingLock(&mPendingLock);
+		if (mPendingSaves.Contains(GetKey(ChunkX, ChunkY))) return true;
+	}
+
+	return Write(*region, MakeArrayView(&chunk, 1));
+}
+
+void FChunkRegionStore::SaveAsync(int32 ChunkX, int32 ChunkY, FChunkBlockStorage&& blocks, bool bOverwrite)
+{
+	if (!bOverwrite && Contains(ChunkX, ChunkY)) return;
+
+	FBlocksPtr pending = MakeShared<const FChunkBlockStorage, ESPMode::ThreadSafe>(MoveTemp(blocks));
+	FRegionPtr region = GetRegion(ChunkX, ChunkY);
+	int32 regionX = GetRegionCoordinate(ChunkX), regionY = GetRegionCoordinate(ChunkY);
+
+	FScopeLock lock(&mPendingLock);
+	if (!bOverwrite && mPendingSaves.Contains(GetKey(ChunkX, ChunkY))) return;
+
+	mPendingSaves.Add(GetKey(ChunkX, ChunkY), pending);
+
+	// The job already queued for the region picks this one up too
+	if (region->bWriteQueued) return;
+	region->bWriteQueued = true;
+
+	mSaveJobs.RemoveAll([](const TFuture<void>& job) { return job.IsReady(); });
+	mSaveJobs.Add(Async(EAsyncExecution::ThreadPool, [this, regionX, regionY]()
+	{
+		WritePending(regionX, regionY);
+	}));
+}
+
+void FChunkRegionStore::Flush()
+{
+	// Workers can queue more saves while this waits
+	for (;;)
+	{
+		TArray<TFuture<void>> jobs;
+		{
+			FScopeLock lock(&mPendingLock);
+			jobs = MoveTemp(mSaveJobs);
+			mSaveJobs.Reset();
+		}
+		if (jobs.Num() == 0) break;
+
+		for (TFuture<void>& job : jobs)
+			job.Wait();
+	}
+}
+
+void FChunkRegionStore::WritePending(int32 regionX, int32 regionY)
+{
+	FRegionPtr region = GetRegion(regionX * RegionSide, regionY * RegionSide);
+
+	// Everything queued for the region so far, saves queued from now on get another job
+	TArray<uint64> keys;
+	TArray<FBlocksPtr> blocks;
+	{
+		FScopeLock lock(&mPendingLock);
+		region->bWriteQueued = false;
+
+		for (const TPair<uint64, FBlocksPtr>& pending : mPendingSaves)
+		{
+			int32 chunkX = int32(uint32(pending.Key >> 32)), chunkY = int32(uint32(pending.Key));
+			if (GetRegionCoordinate(chunkX) != regionX || GetRegionCoordinate(chunkY) != regionY) continue;
+
+			keys.Add(pending.Key);
+			blocks.Add(pending.Value);
+		}
+	}
+	if (keys.Num() == 0) return;
+
+	// Compressed before locking the region, so loads can go on meanwhile
+	TArray<FCompressedChunk> chunks;
+	chunks.SetNum(keys.Num());
+	for (int32 c = 0; c < keys.Num(); c++)
+	{
+		chunks[c].EntryIndex = GetEntryIndex(int32(uint32(keys[c] >> 32)), int32(uint32(keys[c])));
+		if (!Compress(*blocks[c], chunks[c])) chunks[c].Data.Reset();
+	}
+
+	FWriteScopeLock lock(region->Lock);
+
+	// Checked with the region locked, so two saves of the same chunk can't be written out of order
+	TArray<FCompressedChunk> latestChunks;
+	{
+		FScopeLock pendingLock(&mPendingLock);
+		for (int32 c = 0; c < keys.Num(); c++)
+		{
+			FBlocksPtr* latest = mPendingSaves.Find(keys[c]);
+			if (latest && *latest == blocks[c] && chunks[c].Data.Num() > 0) latestChunks.Add(MoveTemp(chunks[c]));
+		}
+	}
+
+	if (latestChunks.Num() > 0 && !Write(*region, latestChunks))
+		UE_LOG(LogTemp, Warning, TEXT("Couldn't save %d chunks to %s"), latestChunks.Num(), *region->Path);
+
+	// Dropped even if the write failed, the chunks are regenerated then
+	FScopeLock pendingLock(&mPendingLock);
+	for (int32 c = 0; c < keys.Num(); c++)
+	{
+		FBlocksPtr* latest = mPendingSaves.Find(keys[c]);
+		if (latest && *latest == blocks[c]) mPendingSaves.Remove(keys[c]);
+	}
+}
+
+FChunkRegionStore::FRegionPtr FChunkRegionStore::GetRegion(int32 ChunkX, int32 ChunkY)
+{
+	int32 regionX = GetRegionCoordinate(ChunkX), regionY = GetRegionCoordinate(ChunkY);
+
+	FScopeLock lock(&mRegionsLock);
+	if (FRegionPtr* found = mRegions.Find(GetKey(regionX, regionY))) return *found;
+
+	FRegionPtr region = MakeShared<FRegion, ESPMode::ThreadSafe>();
+	region->Path = FPaths::Combine(mDirectory, FString::Printf(TEXT("r.%d.%d.region"), regionX, regionY));
+
+	// A missing or unreadable file is an empty region, the first save recreates it
+	TUniquePtr<IFileHandle> file(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*region->Path));
+	if (file && file->Size() >= HEADER_SIZE)
+	{
+		uint32 header[2];
+		if (file->Read(reinterpret_cast<uint8*>(header), sizeof(header)) && header[0] == FILE_MAGIC && header[1] == FILE_VERSION &&
+			file->Read(reinterpret_cast<uint8*>(region->Entries), sizeof(region->Entries)))
+		{
+			region->FileSize = file->Size();
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Ignoring region file %s, it's not a region file of this version"), *region->Path);
+			FMemory::Memzero(region->Entries, sizeof(region->Entries));
+		}
+	}
+
+	mRegions.Add(GetKey(regionX, regionY), region);
+	return region;
+}
+
+bool FChunkRegionStore::MapRegion(FRegion& region)
+{
+	FOpenMappedResult result = FPlatformFileManager::Get().GetPlatformFile().OpenMappedEx(*region.Path);
+	if (result.HasError()) return false;
+
+	region.MappedFile = result.StealValue();
+	region.MappedRegion.Reset(region.MappedFile->MapRegion(0, region.MappedFile->GetFileSize()));
+	if (!region.MappedRegion)
+	{
+		region.MappedFile.Reset();
+		return false;
+	}
+
+	return true;
+}
+
+bool FChunkRegionStore::Compress(const FChunkBlockStorage& blocks, FCompressedChunk& chunk)
+{
+	TArray<uint8> uncompressed;
+	FMemoryWriter writer(uncompressed);
+	blocks.Save(writer);
+
+	int32 compressedSize = FCompression::CompressMemoryBound(NAME_Oodle, uncompressed.Num());
+	chunk.Data.SetNumUninitialized(compressedSize);
+	if (!FCompression::CompressMemory(NAME_Oodle, chunk.Data.GetData(), compressedSize, uncompressed.GetData(), uncompressed.Num()))
+		return false;
+
+	chunk.Data.SetNum(compressedSize, EAllowShrinking::No);
+	chunk.UncompressedSize = uncompressed.Num();
+	return true;
+}
+
+bool FChunkRegionStore::Write(FRegion& region, TArrayView<const FCompressedChunk> chunks)
+{
+	// The file can't be written while it's mapped on every platform. Mapped again once every chunk is
+	// written, unless no load needed it yet
+	bool wasMapped = region.MappedRegion.IsValid();
+	region.MappedRegion.Reset();
+	region.MappedFile.Reset();
+
+	bool written = WriteChunks(region, chunks);
+
+	if (wasMapped && !MapRegion(region))
+		UE_LOG(LogTemp, Warning, TEXT("Couldn't map %s again, it's mapped on the next load"), *region.Path);
+
+	return written;
+}
+
+bool FChunkRegionStore::WriteChunks(FRegion& region, TArrayView<const FCompressedChunk> chunks)
+{
+	IPlatformFile& platformFile = FPlatformFileManager::Get().GetPlatformFile();
+	bool newFile = region.FileSize < HEADER_SIZE;
+	TUniquePtr<IFileHandle> file(platformFile.OpenWrite(*region.Path, !newFile, true));
+	if (!file) return false;
+
+	if (newFile)
+	{
+		uint32 header[2] = { FILE_MAGIC, FILE_VERSION };
+		FMemory::Memzero(region.Entries, sizeof(region.Entries));
+		if (!file->Write(reinterpret_cast<const uint8*>(header), sizeof(header)) ||
+			!file->Write(reinterpret_cast<const uint8*>(region.Entries), sizeof(region.Entries)))
+		{
+			return false;
+		}
+		region.FileSize = HEADER_SIZE;
+	}
+
+	for (const FCompressedChunk& chunk : chunks)
+	{
+		// Overwrite in place if it fits, otherwise append
+		uint32 compressedSize = chunk.Data.Num();
+		FRegionEntry entry = region.Entries[chunk.EntryIndex];
+		if (compressedSize > entry.Capacity)
+		{
+			entry.Offset = uint32(region.FileSize);
+			entry.Capacity = compressedSize;
+		}
+		entry.Size = compressedSize;
+		entry.UncompressedSize = chunk.UncompressedSize;
+
+		// The data goes first, a crash in between leaves the old entry pointing at the old data
+		if (!file->Seek(entry.Offset) || !file->Write(chunk.Data.GetData(), compressedSize)) return false;
+		if (!file->Seek(2 * sizeof(uint32) + chunk.EntryIndex * sizeof(FRegionEntry)) ||
+			!file->Write(reinterpret_cast<const uint8*>(&entry), sizeof(entry)))
+		{
+			return false;
+		}
+
+		region.Entries[chunk.EntryIndex] = entry;
+		region.FileSize = FMath::Max(region.FileSize, int64(entry.Offset) + entry.Capacity);
+	}
+
+	return true;
+}
+
+int32 FChunkRegionStore::GetEntryIndex(int32 ChunkX, int32 ChunkY)
+{
+	int32 localX = ChunkX - GetRegionCoordinate(ChunkX) * RegionSide;
+	int32 localY = ChunkY - GetRegionCoordinate(ChunkY) * RegionSide;
+	return localY * RegionSide + localX;
+}
+
+void FChunkRegionStore::LogLoadBenchmark(const IChunkGenerator& generator, int32 chunkCount)
+{
+	int32 side = FMath::Max(1, FMath::CeilToInt(FMath::Sqrt(float(chunkCount))));
+	chunkCount = side * side;
+
+	FString directory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("RegionBenchmark"));
+	FPlatformFileManager::Get().GetPlatformFile().DeleteDirectoryRecursively(*directory);
+
+	TArray<FChunkBlockStorage> generated;
+	generated.SetNum(chunkCount);
+
+	double start = FPlatformTime::Seconds();
+	int32 dummy;
+	for (int32 c = 0; c < chunkCount; c++)
+		generated[c] = AChunk::GenerateChunkData(c % side, c / side, 16, 16, dummy, dummy, generator);
+	double generateSeconds = FPlatformTime::Seconds() - start;
+
+	double saveSeconds, loadSeconds;
+	int32 mismatches = 0;
+	{
+		FChunkRegionStore store(directory);
+
+		start = FPlatformTime::Seconds();
+		for (int32 c = 0; c < chunkCount; c++)
+			store.Save(c % side, c / side, generated[c]);
+		saveSeconds = FPlatformTime::Seconds() - start;
+	}
+
+	{
+		// A new store, so the tables are read from disk like after a restart
+		FChunkRegionStore store(directory);
+
+		TArray<BlockType> expected, loaded;
+		expected.SetNumUninitialized(16 * 16 * 16);
+		loaded.SetNumUninitialized(16 * 16 * 16);
+
+		start = FPlatformTime::Seconds();
+		TArray<FChunkBlockStorage> loadedChunks;
+		loadedChunks.SetNum(chunkCount);
+		for (int32 c = 0; c < chunkCount; c++)
+			if (!store.Load(c % side, c / side, loadedChunks[c])) mismatches++;
+		loadSeconds = FPlatformTime::Seconds() - start;
+
+		for (int32 c = 0; c < chunkCount; c++)
+		{
+			if (loadedChunks[c].GetSectionCount() != generated[c].GetSectionCount()) continue;
+
+			for (int32 section = 0; section < generated[c].GetSectionCount(); section++)
+			{
+				generated[c].GetSection(section, expected.GetData());
+				loadedChunks[c].GetSection(section, loaded.GetData());
+				if (expected != loaded)
+				{
+					mismatches++;
+					break;
+				}
+			}
+		}
+	}
+
+	int64 bytes = 0;
+	FPlatformFileManager::Get().GetPlatformFile().IterateDirectory(*directory, [&bytes](const TCHAR* path, bool isDirectory)
+	{
+		if (!isDirectory) bytes += FPlatformFileManager::Get().GetPlatformFile().FileSize(path);
+		return true;
+	});
+
+	UE_LOG(LogTemp, Log, TEXT("Region benchmark, %d chunks, %lld KB on disk: generate %.0f chunks/s, save %.0f chunks/s, load %.0f chunks/s (%.1fx generate), %d mismatches"),
+		chunkCount, bytes / 1024, chunkCount / generateSeconds, chunkCount / saveSeconds, chunkCount / loadSeconds,
+		generateSeconds / loadSeconds, mismatches);
+
+	FPlatformFileManager::Get().GetPlatformFile().DeleteDirectoryRecursively(*directory);
+}
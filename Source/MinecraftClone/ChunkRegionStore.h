@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "ChunkBlockStorage.h"
+
+class IChunkGenerator;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+// Saves the blocks of chunks to region files, RegionSide x RegionSide chunks per file. A region file
+// starts with a table holding the offset, size and capacity of every chunk, followed by the chunks,
+// each one a FChunkBlockStorage serialized and compressed on its own. A chunk that grows past its
+// capacity is moved to the end of the file, the old space is never reused.
+// Reads go through a memory mapping of the whole file. The mapping has to be dropped to write the file,
+// so SaveAsync only queues the chunk and a single job per region writes every chunk queued for it with
+// one open of the file, then maps it again once.
+// Load and Save are thread safe and block, SaveAsync copies nothing and saves on the thread pool.
+class MINECRAFTCLONE_API FChunkRegionStore
+{
+public:
+	static const int32 RegionSide = 32;
+
+	// Region files go to directory, which is created if it doesn't exist
+	explicit FChunkRegionStore(const FString& directory);
+
+	// Waits for the saves in flight
+	~FChunkRegionStore();
+
+	// False if the chunk was never saved or its data is corrupted
+	bool Load(int32 ChunkX, int32 ChunkY, FChunkBlockStorage& blocks);
+
+	// True if the chunk was saved, or is being saved
+	bool Contains(int32 ChunkX, int32 ChunkY);
+
+	// Without bOverwrite nothing is written if the chunk is already saved or being saved, for chunks that
+	// were just generated and can't have edits yet
+	bool Save(int32 ChunkX, int32 ChunkY, const FChunkBlockStorage& blocks, bool bOverwrite = true);
+
+	// Loads of the chunk return these blocks from now on, even before they are on disk. Without
+	// bOverwrite nothing is queued if the chunk is already saved or being saved, like Save. Thread safe
+	void SaveAsync(int32 ChunkX, int32 ChunkY, FChunkBlockStorage&& blocks, bool bOverwrite = true);
+
+	// Waits for the saves in flight, including the ones queued meanwhile
+	void Flush();
+
+	const FString& GetDirectory() const { return mDirectory; }
+
+	// Generates chunkCount chunks in a square, saves them to an empty directory and loads them back,
+	// checks the loaded blocks are the same and logs the chunks per second of each step
+	static void LogLoadBenchmark(const IChunkGenerator& generator, int32 chunkCount);
+
+private:
+	static const uint32 FILE_MAGIC = 0x4752434D; // MCRG
+	static const uint32 FILE_VERSION = 1;
+
+	struct FRegionEntry
+	{
+		uint32 Offset = 0;
+		// Compressed size, 0 if the chunk isn't in the file
+		uint32 Size = 0;
+		uint32 Capacity = 0;
+		uint32 UncompressedSize = 0;
+	};
+
+	static const int64 HEADER_SIZE = 2 * sizeof(uint32) + RegionSide * RegionSide * sizeof(FRegionEntry);
+
+	struct FRegion
+	{
+		FString Path;
+		// Loads share the lock, saves and (re)mapping the file take it exclusively
+		FRWLock Lock;
+		FRegionEntry Entries[RegionSide * RegionSide];
+		int64 FileSize = 0;
+		TUniquePtr<IMappedFileHandle> MappedFile;
+		TUniquePtr<IMappedFileRegion> MappedRegion;
+
+		// A write job is queued and hasn't picked up the pending saves yet, under mPendingLock
+		bool bWriteQueued = false;
+
+		~FRegion();
+	};
+
+	typedef TSharedPtr<FRegion, ESPMode::ThreadSafe> FRegionPtr;
+	typedef TSharedPtr<const FChunkBlockStorage, ESPMode::ThreadSafe> FBlocksPtr;
+
+	FString mDirectory;
+
+	TMap<uint64, FRegionPtr> mRegions;
+	FCriticalSection mRegionsLock;
+
+	// Latest blocks given to SaveAsync that aren't written yet
+	TMap<uint64, FBlocksPtr> mPendingSaves;
+	// Also guards mSaveJobs and FRegion::bWriteQueued
+	FCriticalSection mPendingLock;
+
+	TArray<TFuture<void>> mSaveJobs;
+
+	// Opens the region and reads its table the first time
+	FRegionPtr GetRegion(int32 ChunkX, int32 ChunkY);
+
+	// Maps the whole file, with the lock held exclusively
+	bool MapRegion(FRegion& region);
+
+	// A chunk serialized and compressed, ready for Write
+	struct FCompressedChunk
+	{
+		int32 EntryIndex = 0;
+		uint32 UncompressedSize = 0;
+		TArray<uint8> Data;
+	};
+
+	static bool Compress(const FChunkBlockStorage& blocks, FCompressedChunk& chunk);
+
+	// Writes the chunks with a single open of the file, with the lock held exclusively. The mapping is
+	// dropped first and made again at the end if loads were using it
+	bool Write(FRegion& region, TArrayView<const FCompressedChunk> chunks);
+
+	// The file part of Write, the file is closed when it returns
+	bool WriteChunks(FRegion& region, TArrayView<const FCompressedChunk> chunks);
+
+	// Writes every pending save of the region, except the ones replaced by newer blocks meanwhile
+	void WritePending(int32 regionX, int32 regionY);
+
+	static int32 GetEntryIndex(int32 ChunkX, int32 ChunkY);
+
+	static uint64 GetKey(int32 X, int32 Y) { return (uint64(uint32(X)) << 32) | uint32(Y); }
+};
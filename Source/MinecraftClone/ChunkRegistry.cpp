@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkRegistry.h"
+
+AChunk* FChunkRegistry::Find(int32 ChunkX, int32 ChunkY) const
+{
+	int64 key = GetKey(ChunkX, ChunkY);
+	const FShard& shard = GetShard(key);
+
+	FReadScopeLock lock(shard.Lock);
+	const FEntry* entry = shard.Entries.Find(key);
+
+	return entry && entry->State != EChunkState::Unloading ? entry->Chunk : nullptr;
+}
+
+EChunkState FChunkRegistry::GetState(int32 ChunkX, int32 ChunkY) const
+{
+	int64 key = GetKey(ChunkX, ChunkY);
+	const FShard& shard = GetShard(key);
+
+	FReadScopeLock lock(shard.Lock);
+	const FEntry* entry = shard.Entries.Find(key);
+
+	return entry ? entry->State : EChunkState::None;
+}
+
+void FChunkRegistry::SetState(int32 ChunkX, int32 ChunkY, EChunkState state)
+{
+	int64 key = GetKey(ChunkX, ChunkY);
+	FShard& shard = GetShard(key);
+
+	FWriteScopeLock lock(shard.Lock);
+	if (state == EChunkState::None)
+	{
+		// Dropped requests, the placed chunks are removed by AChunk::Release
+		const FEntry* entry = shard.Entries.Find(key);
+		if (entry && !entry->Chunk) shard.Entries.Remove(key);
+		return;
+	}
+
+	shard.Entries.FindOrAdd(key).State = state;
+}
+
+bool FChunkRegistry::Place(int32 ChunkX, int32 ChunkY, AChunk* chunk)
+{
+	int64 key = GetKey(ChunkX, ChunkY);
+	FShard& shard = GetShard(key);
+
+	FWriteScopeLock lock(shard.Lock);
+	FEntry& entry = shard.Entries.FindOrAdd(key);
+	if (entry.Chunk) return false;
+
+	entry.Chunk = chunk;
+	entry.State = EChunkState::Meshed;
+	mPlacedCount++;
+
+	return true;
+}
+
+void FChunkRegistry::Remove(int32 ChunkX, int32 ChunkY)
+{
+	int64 key = GetKey(ChunkX, ChunkY);
+	FShard& shard = GetShard(key);
+
+	FWriteScopeLock lock(shard.Lock);
+	FEntry entry;
+	if (shard.Entries.RemoveAndCopyValue(key, entry) && entry.Chunk) mPlacedCount--;
+}
+
+void FChunkRegistry::Empty()
+{
+	for (FShard& shard : mShards)
+	{
+		FWriteScopeLock lock(shard.Lock);
+		shard.Entries.Empty();
+	}
+
+	mPlacedCount = 0;
+}
+
+void FChunkRegistry::GetChunks(TArray<AChunk*>& chunks) const
+{
+	chunks.Reset(Num());
+
+	for (const FShard& shard : mShards)
+	{
+		FReadScopeLock lock(shard.Lock);
+		for (const TPair<int64, FEntry>& entry : shard.Entries)
+		{
+			if (entry.Value.Chunk && entry.Value.State != EChunkState::Unloading) chunks.Add(entry.Value.Chunk);
+		}
+	}
+}
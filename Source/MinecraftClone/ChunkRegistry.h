@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/ScopeRWLock.h"
+#include <atomic>
+
+class AChunk;
+
+// Where a chunk is between being requested and going away. A chunk without an entry isn't loaded or requested
+enum class EChunkState : uint8
+{
+	None,
+	// Waiting in the FChunkLoadScheduler
+	Requested,
+	// Its job is running on the thread pool
+	Generating,
+	// Built, its sections wait in the FChunkUploadQueue. It has an actor once the first one is uploaded
+	Meshed,
+	// Every section was uploaded
+	Uploaded,
+	// Being released, lookups don't return the actor anymore
+	Unloading
+};
+
+// Every loaded or requested chunk, by position. Keys are both coordinates in 64 bits, so chunks far
+// away from the origin don't collide. The map is split in shards with a read/write lock each, lookups
+// from workers only wait for writes to the same shard and never for each other.
+// The actors are only safe to use on the game thread, or while it waits for the workers.
+class MINECRAFTCLONE_API FChunkRegistry
+{
+public:
+	static int64 GetKey(int32 ChunkX, int32 ChunkY) { return (int64(ChunkX) << 32) | uint32(ChunkY); }
+
+	// Null unless the chunk was placed and isn't unloading
+	AChunk* Find(int32 ChunkX, int32 ChunkY) const;
+
+	EChunkState GetState(int32 ChunkX, int32 ChunkY) const;
+
+	// Adds the entry if it isn't there, None removes it unless the chunk has an actor
+	void SetState(int32 ChunkX, int32 ChunkY, EChunkState state);
+
+	// Gives the chunk its actor, Meshed until its sections are uploaded. False if it already has one
+	bool Place(int32 ChunkX, int32 ChunkY, AChunk* chunk);
+
+	void Remove(int32 ChunkX, int32 ChunkY);
+
+	void Empty();
+
+	// Chunks with an actor
+	int32 Num() const { return mPlacedCount.load(std::memory_order_relaxed); }
+
+	// Copy of the chunks with an actor, so the caller can release them while going through it
+	void GetChunks(TArray<AChunk*>& chunks) const;
+
+private:
+	static const int32 ShardCount = 16;
+
+	struct FEntry
+	{
+		AChunk* Chunk = nullptr;
+		EChunkState State = EChunkState::None;
+	};
+
+	struct FShard
+	{
+		mutable FRWLock Lock;
+		TMap<int64, FEntry> Entries;
+	};
+
+	FShard mShards[ShardCount];
+
+	std::atomic<int32> mPlacedCount { 0 };
+
+	// Neighboring chunks land in different shards
+	FShard& GetShard(int64 key) { return mShards[GetTypeHash(key) & (ShardCount - 1)]; }
+	const FShard& GetShard(int64 key) const { return mShards[GetTypeHash(key) & (ShardCount - 1)]; }
+};
@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkRemeshQueue.h"
+#include "ChunkStats.h"
+#include "Async/Async.h"
+#include "Algo/StableSort.h"
+#include "ChunkLod.h"
+
+FChunkRemeshQueue::FChunkRemeshQueue() :
+	mFinishedJobs(MakeShared<FFinishedJobQueue, ESPMode::ThreadSafe>())
+{
+}
+
+FChunkRemeshQueue::~FChunkRemeshQueue()
+{
+	CancelAll();
+}
+
+void FChunkRemeshQueue::Tick()
+{
+	CHUNK_STAGE_SCOPE(STAT_ChunkRemesh, Remesh);
+
+	UploadFinished();
+
+	mRunningJobs.RemoveAll([](const TFuture<void>& job) { return job.IsReady(); });
+
+	TArray<int32> urgentJobs;
+	StartJobs(urgentJobs);
+
+	// Fast path, a single block edit is a handful of sections that mesh in well under a millisecond
+	if (urgentJobs.Num() == 0 || urgentJobs.Num() > FastPathMaxSections) return;
+
+	double deadline = FPlatformTime::Seconds() + FastPathMilliseconds / 1000.0;
+	for (int32 job : urgentJobs)
+	{
+		double remaining = deadline - FPlatformTime::Seconds();
+		if (remaining <= 0.0 || !mRunningJobs[job].WaitFor(FTimespan::FromSeconds(remaining))) break;
+	}
+
+	UploadFinished();
+}
+
+void FChunkRemeshQueue::CancelAll()
+{
+	// The jobs read the block registry and give their MeshData back to the pool, which are torn down
+	// after this, so the running ones are waited for. Nothing they return is read again
+	for (TFuture<void>& running : mRunningJobs) running.Wait();
+	mRunningJobs.Empty();
+
+	FSectionJobPtr job;
+	while (mFinishedJobs->Dequeue(job)) {}
+
+	mFinishedJobs = MakeShared<FFinishedJobQueue, ESPMode::ThreadSafe>();
+}
+
+void FChunkRemeshQueue::UploadFinished()
+{
+	FSectionJobPtr job;
+	while (mFinishedJobs->Dequeue(job))
+	{
+		// The version changes when the section is edited again and when the chunk is released
+		AChunk* chunk = job->Chunk.Get();
+		if (!IsValid(chunk) || chunk->mSectionVersions[job->Section] != job->Version) continue;
+
+		chunk->UploadSection(job->Section, job->Result);
+	}
+}
+
+void FChunkRemeshQueue::StartJobs(TArray<int32>& urgentJobs)
+{
+	int32 started = 0;
+	TArray<TWeakObjectPtr<AChunk>> stillDirty;
+
+	// Block edits go before LOD changes and neighbor fixups, which can be hundreds of sections at once
+	Algo::StableSortBy(AChunk::DirtyChunks, [](const TWeakObjectPtr<AChunk>& weakChunk)
+	{
+		AChunk* chunk = weakChunk.Get();
+		return IsValid(chunk) && chunk->mUrgentSections != 0 ? 0 : 1;
+	});
+
+	for (TWeakObjectPtr<AChunk>& weakChunk : AChunk::DirtyChunks)
+	{
+		AChunk* chunk = weakChunk.Get();
+		if (!IsValid(chunk) || chunk->mDirtySections == 0) continue;
+
+		if (started >= MaxSectionsPerTick)
+		{
+			stillDirty.Add(weakChunk);
+			continue;
+		}
+
+		TSharedPtr<FChunkSnapshot, ESPMode::ThreadSafe> snapshot = MakeShared<FChunkSnapshot, ESPMode::ThreadSafe>();
+		snapshot->lod = chunk->mLod;
+		if (chunk->mLod == 0)
+		{
+			snapshot->blocks = chunk->mBlocks;
+			snapshot->borders = chunk->GetBorders();
+			snapshot->light = chunk->mLight;
+		}
+		else
+		{
+			snapshot->blocks = FChunkLod::Downsample(chunk->mBlocks, chunk->mLod);
+			snapshot->borders = FChunkLod::DownsampleBorders(chunk->GetBorders(), chunk->mSectionSide, chunk->mLod);
+		}
+		FChunkSnapshotPtr sharedSnapshot = snapshot;
+
+		for (int32 section = 0; section < chunk->mSectionCount; section++)
+		{
+			if (!(chunk->mDirtySections & (1u << section))) continue;
+
+			FSectionJobPtr job = MakeShared<FSectionJob, ESPMode::ThreadSafe>();
+			job->Chunk = chunk;
+			job->ChunkX = chunk->mChunkX; job->ChunkY = chunk->mChunkY;
+			job->Section = section;
+			job->Version = chunk->mSectionVersions[section];
+
+			TFunction<void()> SectionTask = [job, finishedJobs = mFinishedJobs, snapshot = sharedSnapshot,
+				meshingMode = chunk->mMeshingMode]()
+			{
+				job->Result = AChunk::GetLodMeshData(job->ChunkX, job->ChunkY, job->Section,
+					FChunkVolumeView(snapshot->blocks, &snapshot->borders, snapshot->lod == 0 ? &snapshot->light : nullptr),
+					meshingMode, snapshot->lod);
+
+				finishedJobs->Enqueue(job);
+			};
+
+			int32 running = mRunningJobs.Add(Async(EAsyncExecution::ThreadPool, MoveTemp(SectionTask)));
+			if (chunk->mUrgentSections & (1u << section)) urgentJobs.Add(running);
+
+			started++;
+		}
+
+		chunk->mDirtySections = 0;
+		chunk->mUrgentSections = 0;
+	}
+
+	AChunk::DirtyChunks = MoveTemp(stillDirty);
+}
@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "Async/Future.h"
+#include "Chunk.h"
+
+// Remeshes the sections flagged with AChunk::MarkSectionDirty. Every Tick the dirty sections of all
+// chunks are meshed on the thread pool against a copy of the chunk blocks and borders, one job per
+// section, and each result replaces its section in a single upload once it's back, unless the section
+// was dirtied again meanwhile (a newer job is coming). Edits in the same frame end up in the same job.
+// Block edits are urgent, when only a few urgent sections are dirty the game thread waits a bit for
+// them so the edit shows up on the same frame.
+// Everything but the jobs runs on the game thread.
+class MINECRAFTCLONE_API FChunkRemeshQueue
+{
+public:
+	FChunkRemeshQueue();
+	~FChunkRemeshQueue();
+
+	// Sections started per Tick, the dirty sections of a chunk always start together
+	int32 MaxSectionsPerTick = 32;
+
+	// The game thread waits for the urgent sections only if there are at most this many
+	int32 FastPathMaxSections = 4;
+
+	// And for at most this long, whatever isn't done by then is uploaded on the next Tick
+	float FastPathMilliseconds = 2.0f;
+
+	// Uploads the finished sections and starts the jobs of the dirty ones
+	void Tick();
+
+	// Drops everything in flight and waits for the jobs that are running, their results are thrown away
+	void CancelAll();
+
+private:
+	// Downsampled when the chunk is at a LOD, see FChunkLod, the light is only copied at full resolution
+	struct FChunkSnapshot
+	{
+		FChunkBlockStorage blocks;
+		FChunkBorders borders;
+		FChunkLightStorage light;
+		int32 lod = 0;
+	};
+
+	typedef TSharedPtr<const FChunkSnapshot, ESPMode::ThreadSafe> FChunkSnapshotPtr;
+
+	struct FSectionJob
+	{
+		TWeakObjectPtr<AChunk> Chunk;
+		int32 ChunkX;
+		int32 ChunkY;
+		int32 Section;
+		// AChunk::mSectionVersions of the section when the snapshot was taken
+		uint32 Version;
+		MeshData* Result = nullptr;
+
+		~FSectionJob() { FMeshDataPool::Release(Result); }
+	};
+
+	typedef TSharedPtr<FSectionJob, ESPMode::ThreadSafe> FSectionJobPtr;
+	typedef TQueue<FSectionJobPtr, EQueueMode::Mpsc> FFinishedJobQueue;
+
+	// Shared with the workers so a job finishing after the queue is gone has somewhere to go
+	TSharedRef<FFinishedJobQueue, ESPMode::ThreadSafe> mFinishedJobs;
+
+	// Jobs started and not known to be done, the finished ones are dropped every Tick
+	TArray<TFuture<void>> mRunningJobs;
+
+	void UploadFinished();
+
+	// Starts the jobs of the dirty chunks, the indices in mRunningJobs of the urgent sections go to urgentJobs
+	void StartJobs(TArray<int32>& urgentJobs);
+};
@@ -0,0 +1,146 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkStats.h"
+#include "Chunk.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_STAT(STAT_ChunkGenerate);
+DEFINE_STAT(STAT_ChunkDecorate);
+DEFINE_STAT(STAT_ChunkLight);
+DEFINE_STAT(STAT_ChunkRelight);
+DEFINE_STAT(STAT_ChunkLoad);
+DEFINE_STAT(STAT_ChunkMesh);
+DEFINE_STAT(STAT_ChunkEnqueue);
+DEFINE_STAT(STAT_ChunkUpload);
+DEFINE_STAT(STAT_ChunkRemesh);
+DEFINE_STAT(STAT_ChunkCollision);
+DEFINE_STAT(STAT_ChunkCollisionBoxes);
+DEFINE_STAT(STAT_ChunkVisibility);
+
+DEFINE_STAT(STAT_ChunkPendingRequests);
+DEFINE_STAT(STAT_ChunkJobsInFlight);
+DEFINE_STAT(STAT_ChunkUploadBacklog);
+DEFINE_STAT(STAT_ChunkDirty);
+DEFINE_STAT(STAT_ChunkLoaded);
+DEFINE_STAT(STAT_ChunkTimeToVisible);
+DEFINE_STAT(STAT_ChunkBlockMemory);
+DEFINE_STAT(STAT_ChunkBlockMemoryPerChunk);
+DEFINE_STAT(STAT_ChunkMeshDataAllocations);
+DEFINE_STAT(STAT_ChunkMeshDataReuses);
+DEFINE_STAT(STAT_ChunkQuadGrowths);
+DEFINE_STAT(STAT_ChunkMeshDataPooled);
+DEFINE_STAT(STAT_ChunkMeshDataPoolMemory);
+
+CSV_DEFINE_CATEGORY_MODULE(MINECRAFTCLONE_API, Chunks, true);
+
+#if !UE_BUILD_SHIPPING
+// In milliseconds, 50 ms bins up to 5 s
+static FHistogram& GetTimeToVisibleHistogram()
+{
+	static FHistogram histogram = []()
+	{
+		FHistogram result;
+		result.InitLinear(0.0, 5000.0, 50.0);
+		return result;
+	}();
+
+	return histogram;
+}
+#endif
+
+#if STATS || CSV_PROFILER
+static bool IsRecording()
+{
+#if STATS
+	if (FThreadStats::IsCollectingData()) return true;
+#endif
+#if CSV_PROFILER
+	if (FCsvProfiler::Get()->IsCapturing()) return true;
+#endif
+	return false;
+}
+#endif
+
+void FChunkStats::SetCounters(int32 pendingRequests, int32 jobsInFlight, int32 uploadBacklog)
+{
+#if STATS || CSV_PROFILER
+	if (!IsRecording()) return;
+
+	TArray<AChunk*> chunks;
+	AChunk::ChunkRegistry.GetChunks(chunks);
+
+	int32 loadedChunks = chunks.Num(), dirtyChunks = AChunk::DirtyChunks.Num();
+	SIZE_T blockMemory = 0;
+	for (const AChunk* chunk : chunks)
+		blockMemory += chunk->GetBlockMemory();
+	SIZE_T blockMemoryPerChunk = loadedChunks > 0 ? blockMemory / loadedChunks : 0;
+
+	// Per frame, a steady stream of chunks should be all reuses
+	FMeshDataPool::FCounters meshData = FMeshDataPool::TakeCounters();
+
+	SET_DWORD_STAT(STAT_ChunkPendingRequests, pendingRequests);
+	SET_DWORD_STAT(STAT_ChunkJobsInFlight, jobsInFlight);
+	SET_DWORD_STAT(STAT_ChunkUploadBacklog, uploadBacklog);
+	SET_DWORD_STAT(STAT_ChunkDirty, dirtyChunks);
+	SET_DWORD_STAT(STAT_ChunkLoaded, loadedChunks);
+	SET_MEMORY_STAT(STAT_ChunkBlockMemory, blockMemory);
+	SET_MEMORY_STAT(STAT_ChunkBlockMemoryPerChunk, blockMemoryPerChunk);
+	SET_DWORD_STAT(STAT_ChunkMeshDataAllocations, meshData.Allocations);
+	SET_DWORD_STAT(STAT_ChunkMeshDataReuses, meshData.Reuses);
+	SET_DWORD_STAT(STAT_ChunkQuadGrowths, meshData.Growths);
+	SET_DWORD_STAT(STAT_ChunkMeshDataPooled, meshData.Pooled);
+	SET_MEMORY_STAT(STAT_ChunkMeshDataPoolMemory, meshData.PooledBytes);
+
+	CSV_CUSTOM_STAT(Chunks, PendingRequests, pendingRequests, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Chunks, JobsInFlight, jobsInFlight, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Chunks, SectionsToUpload, uploadBacklog, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Chunks, DirtyChunks, dirtyChunks, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Chunks, LoadedChunks, loadedChunks, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Chunks, BlockMemoryKB, float(blockMemory / 1024.0), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Chunks, BlockMemoryPerChunkKB, float(blockMemoryPerChunk / 1024.0), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Chunks, MeshDataAllocations, meshData.Allocations, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Chunks, MeshDataReuses, meshData.Reuses, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Chunks, QuadBufferGrowths, meshData.Growths, ECsvCustomStatOp::Set);
+#endif
+}
+
+void FChunkStats::AddTimeToVisible(double seconds)
+{
+	float milliseconds = float(seconds * 1000.0);
+
+	SET_FLOAT_STAT(STAT_ChunkTimeToVisible, milliseconds);
+	CSV_CUSTOM_STAT(Chunks, TimeToVisibleMs, milliseconds, ECsvCustomStatOp::Max);
+
+#if !UE_BUILD_SHIPPING
+	GetTimeToVisibleHistogram().AddMeasurement(milliseconds);
+#endif
+}
+
+void FChunkStats::DumpTimeToVisible()
+{
+#if !UE_BUILD_SHIPPING
+	FHistogram& histogram = GetTimeToVisibleHistogram();
+	if (histogram.GetNumMeasurements() == 0) return;
+
+	histogram.DumpToLog(TEXT("Chunk time to visible (ms)"));
+
+	FString csv = TEXT("lower_ms,upper_ms,chunks,sum_ms\n");
+	for (int32 bin = 0; bin < histogram.GetNumBins(); bin++)
+	{
+		csv += FString::Printf(TEXT("%f,%f,%d,%f\n"), histogram.GetBinLowerBound(bin), histogram.GetBinUpperBound(bin),
+			histogram.GetBinObservationsCount(bin), histogram.GetBinObservationsSum(bin));
+	}
+
+	FString path = FPaths::Combine(FPaths::ProfilingDir(), TEXT("ChunkTimeToVisible.csv"));
+	if (FFileHelper::SaveStringToFile(csv, *path))
+		UE_LOG(LogTemp, Log, TEXT("Chunk time to visible histogram written to %s"), *path);
+#endif
+}
+
+void FChunkStats::ResetTimeToVisible()
+{
+#if !UE_BUILD_SHIPPING
+	GetTimeToVisibleHistogram().Reset();
+#endif
+}
@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ProfilingDebugging/Histogram.h"
+
+// "stat Chunks" in the console. Everything here compiles out with the stats system, the CSV profiler
+// and the trace, so the hot paths cost nothing when they're disabled
+DECLARE_STATS_GROUP(TEXT("Chunks"), STATGROUP_Chunks, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate"), STAT_ChunkGenerate, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Decorate"), STAT_ChunkDecorate, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Light"), STAT_ChunkLight, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Relight"), STAT_ChunkRelight, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Load from region"), STAT_ChunkLoad, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Mesh section"), STAT_ChunkMesh, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Enqueue"), STAT_ChunkEnqueue, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Upload"), STAT_ChunkUpload, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Remesh"), STAT_ChunkRemesh, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Collision"), STAT_ChunkCollision, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Collision boxes"), STAT_ChunkCollisionBoxes, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Visibility"), STAT_ChunkVisibility, STATGROUP_Chunks, MINECRAFTCLONE_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pending requests"), STAT_ChunkPendingRequests, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Jobs in flight"), STAT_ChunkJobsInFlight, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Sections to upload"), STAT_ChunkUploadBacklog, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Dirty chunks"), STAT_ChunkDirty, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Loaded chunks"), STAT_ChunkLoaded, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Time to visible (ms)"), STAT_ChunkTimeToVisible, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Block memory"), STAT_ChunkBlockMemory, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Block memory per chunk"), STAT_ChunkBlockMemoryPerChunk, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("MeshData allocated"), STAT_ChunkMeshDataAllocations, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("MeshData reused"), STAT_ChunkMeshDataReuses, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Quad buffers grown"), STAT_ChunkQuadGrowths, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pooled MeshData"), STAT_ChunkMeshDataPooled, STATGROUP_Chunks, MINECRAFTCLONE_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Pooled MeshData memory"), STAT_ChunkMeshDataPoolMemory, STATGROUP_Chunks, MINECRAFTCLONE_API);
+
+// Same numbers in "csvprofile start" / -csvCaptureFrames captures
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(MINECRAFTCLONE_API, Chunks);
+
+// Cycle stat, trace event and CSV timing of a pipeline stage
+#define CHUNK_STAGE_SCOPE(Stat, Name) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(Chunk##Name); \
+	CSV_SCOPED_TIMING_STAT(Chunks, Name)
+
+// The per frame counters and the time it takes a requested chunk to show up
+class MINECRAFTCLONE_API FChunkStats
+{
+public:
+	// Once per frame on the game thread, does nothing unless stats or a CSV capture are being recorded
+	static void SetCounters(int32 pendingRequests, int32 jobsInFlight, int32 uploadBacklog);
+
+	// From FChunkLoadScheduler::Request to the upload of the last section of the chunk
+	static void AddTimeToVisible(double seconds);
+
+	// Logs the time to visible histogram and writes it to Saved/Profiling/ChunkTimeToVisible.csv
+	static void DumpTimeToVisible();
+
+	static void ResetTimeToVisible();
+};
@@ -0,0 +1,123 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkUploadQueue.h"
+#include "ChunkStats.h"
+
+void FChunkUploadQueue::Add(TUniquePtr<FChunkBuildResult> chunk)
+{
+	FPendingChunkPtr pending = MakeShared<FPendingChunk>();
+	pending->RemainingSections = chunk->sections.Num();
+	pending->Build = MoveTemp(chunk);
+
+	// Priorities are set on the next Tick
+	for (int32 section = 0; section < pending->RemainingSections; section++)
+		mPending.Add(FPendingSection{ pending, section, 0.0 });
+}
+
+void FChunkUploadQueue::Tick(UWorld* World, const FVector& playerLocation)
+{
+	CHUNK_STAGE_SCOPE(STAT_ChunkUpload, Upload);
+
+	double startTime = FPlatformTime::Seconds();
+
+	if (mPending.Num() == 0)
+	{
+		mLastTickMilliseconds = 0.0f;
+		return;
+	}
+
+	// The player moves every frame, so the whole heap is rebuilt
+	for (FPendingSection& pending : mPending)
+	{
+		const FChunkBuildResult& build = *pending.Chunk->Build;
+		const MeshData& section = *build.sections[pending.Section];
+		int32 sectionSize = section.sectionSide * section.lodScale * AChunk::BlockSize;
+
+		FVector center = AChunk::GetChunkOrigin(build.chunkX, build.chunkY) +
+			FVector(sectionSize / 2, sectionSize / 2, sectionSize * pending.Section + sectionSize / 2);
+		pending.Priority = FVector::DistSquared(center, playerLocation);
+	}
+	mPending.Heapify(FPriorityLess());
+
+	double deadline = startTime + BudgetMilliseconds / 1000.0;
+	do
+	{
+		FPendingSection pending;
+		mPending.HeapPop(pending, FPriorityLess(), EAllowShrinking::No);
+
+		FPendingChunk& chunk = *pending.Chunk;
+		if (!chunk.bPlaced && !Place(World, chunk)) chunk.bDropped = true;
+		if (!chunk.bDropped) UploadSection(pending);
+
+		chunk.RemainingSections--;
+		if (chunk.RemainingSections > 0 || chunk.bDropped) continue;
+
+		// Last section of the chunk, same as the end of AChunk::CreateChunk
+		AChunk* actor = chunk.Actor.Get();
+		if (IsValid(actor) && AChunk::FindChunk(chunk.Build->chunkX, chunk.Build->chunkY) == actor)
+		{
+			if (chunk.bHidden) actor->SetActorHiddenInGame(false);
+			actor->RemeshStaleNeighbors();
+			actor->UpdateLod();
+			AChunk::ChunkRegistry.SetState(chunk.Build->chunkX, chunk.Build->chunkY, EChunkState::Uploaded);
+
+			if (chunk.Build->requestSeconds > 0.0) FChunkStats::AddTimeToVisible(FPlatformTime::Seconds() - chunk.Build->requestSeconds);
+		}
+	} while (mPending.Num() > 0 && FPlatformTime::Seconds() < deadline);
+
+	mLastTickMilliseconds = float((FPlatformTime::Seconds() - startTime) * 1000.0);
+}
+
+void FChunkUploadQueue::SetCenter(int32 ChunkX, int32 ChunkY, int32 renderDistance)
+{
+	// Placed chunks have an actor, AChunk::PlayerMovedToAnotherChunk releases those
+	for (int32 p = mPending.Num() - 1; p >= 0; p--)
+	{
+		const FPendingChunk& chunk = *mPending[p].Chunk;
+		if (chunk.bPlaced) continue;
+
+		if (FMath::Abs(chunk.Build->chunkX - ChunkX) > renderDistance || FMath::Abs(chunk.Build->chunkY - ChunkY) > renderDistance)
+		{
+			// So it's requested again if the player comes back
+			AChunk::ChunkRegistry.SetState(chunk.Build->chunkX, chunk.Build->chunkY, EChunkState::None);
+			mPending.RemoveAtSwap(p);
+		}
+	}
+}
+
+void FChunkUploadQueue::Empty()
+{
+	mPending.Empty();
+}
+
+bool FChunkUploadQueue::Place(UWorld* World, FPendingChunk& chunk)
+{
+	chunk.bPlaced = true;
+
+	// The sections the light stitching dirties are remeshed with the stitched light, the built ones
+	// are older and mustn't replace them
+	AChunk* actor = AChunk::PlaceChunk(World, *chunk.Build, chunk.Versions);
+	if (!actor) return false;
+
+	chunk.Actor = actor;
+
+	// A pooled actor still has the sections of the chunk it held before
+	if (actor->mesh->GetNumSections() > 0)
+	{
+		actor->SetActorHiddenInGame(true);
+		chunk.bHidden = true;
+	}
+
+	return true;
+}
+
+void FChunkUploadQueue::UploadSection(const FPendingSection& pending)
+{
+	const FPendingChunk& chunk = *pending.Chunk;
+
+	// Released, or the section was edited and remeshed after the chunk was placed
+	AChunk* actor = chunk.Actor.Get();
+	if (!IsValid(actor) || actor->mSectionVersions[pending.Section] != chunk.Versions[pending.Section]) return;
+
+	actor->UploadSection(pending.Section, chunk.Build->sections[pending.Section]);
+}
@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Chunk.h"
+
+// Uploads generated chunks to their actors section by section, closest sections to the player first,
+// spending at most BudgetMilliseconds of the game thread per Tick (always at least one section).
+// A chunk is placed in the ChunkRegistry when its first section comes up, pooled actors stay hidden until
+// all their sections are replaced so they don't show the chunk they held before.
+// Game thread only.
+class MINECRAFTCLONE_API FChunkUploadQueue
+{
+public:
+	float BudgetMilliseconds = 4.0f;
+
+	void Add(TUniquePtr<FChunkBuildResult> chunk);
+
+	void Tick(UWorld* World, const FVector& playerLocation);
+
+	// Drops the chunks that weren't placed yet and are further than renderDistance (in chunks, on either axis)
+	void SetCenter(int32 ChunkX, int32 ChunkY, int32 renderDistance);
+
+	void Empty();
+
+	// Sections waiting to be uploaded
+	int32 GetBacklog() const { return mPending.Num(); }
+
+	// Game thread time spent by the last Tick
+	float GetLastTickMilliseconds() const { return mLastTickMilliseconds; }
+
+private:
+	struct FPendingChunk
+	{
+		TUniquePtr<FChunkBuildResult> Build;
+		TWeakObjectPtr<AChunk> Actor;
+		bool bPlaced = false;
+		bool bDropped = false;
+		bool bHidden = false;
+		int32 RemainingSections = 0;
+		// AChunk::mSectionVersions when the chunk was placed, before the light stitching. A section stitched
+		// or edited since then is newer
+		uint32 Versions[32] = {};
+	};
+
+	typedef TSharedPtr<FPendingChunk> FPendingChunkPtr;
+
+	struct FPendingSection
+	{
+		FPendingChunkPtr Chunk;
+		int32 Section;
+		double Priority;
+	};
+
+	struct FPriorityLess
+	{
+		bool operator()(const FPendingSection& A, const FPendingSection& B) const { return A.Priority < B.Priority; }
+	};
+
+	// Min-heap on Priority, the squared distance from the player to the center of the section
+	TArray<FPendingSection> mPending;
+
+	float mLastTickMilliseconds = 0.0f;
+
+	// Returns false if the chunk can't be placed and its sections have to be dropped
+	bool Place(UWorld* World, FPendingChunk& chunk);
+
+	void UploadSection(const FPendingSection& pending);
+};
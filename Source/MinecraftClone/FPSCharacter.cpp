@@ -2,9 +2,11 @@
 
 
 #include "FPSCharacter.h"
+#include "ChunkStats.h"
 #include "Engine/World.h"
 #include "DamageableActor.h"
 #include "Chunk.h"
+#include "Misc/Paths.h"
 
 // Sets default values
 AFPSCharacter::AFPSCharacter()
@@ -19,16 +21,81 @@ void AFPSCharacter::BeginPlay()
 {
 	Super::BeginPlay();
 
-	AChunk::ChunkMap.Empty();
+	// Before anything is generated, the block tables are only read after this
+	FBlockRegistry::Initialize(CHUNK_BLOCK_TABLE);
+
+	AChunk::ChunkRegistry.Empty();
+	AChunk::ChunkPool.Empty();
+	AChunk::DirtyChunks.Empty();
+	AChunk::VisibilityGraph.Empty();
+	FChunkStats::ResetTimeToVisible();
+
+	if (PopulateBlockFunction)
+		chunkGenerator = MakeShared<FCallbackChunkGenerator, ESPMode::ThreadSafe>(PopulateBlockFunction, true);
+	else if (CHUNK_USE_BLUEPRINT_GENERATOR)
+		chunkGenerator = MakeShared<FCallbackChunkGenerator, ESPMode::ThreadSafe>([this](int32 i, int32 j, int32 k) {
+			return BlueprintPopulateBlock(i, j, k);
+		}, false);
+	else
+		chunkGenerator = MakeShared<FNoiseTerrainGenerator, ESPMode::ThreadSafe>(TERRAIN_PARAMS);
+
+	AChunk::RegionStore.Reset();
+	if (CHUNK_SAVE_WORLD)
+		AChunk::RegionStore = MakeShared<FChunkRegionStore, ESPMode::ThreadSafe>(FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Worlds"), CHUNK_WORLD_NAME));
+
+	if (CHUNK_MESHING_MODE == MeshingMode::GREEDY && !AChunk::HasGreedyMaterial())
+	{
+		UE_LOG(LogTemp, Error, TEXT("CHUNK_MESHING_MODE is GREEDY but there's no greedy material, using PER_FACE"));
+		CHUNK_MESHING_MODE = MeshingMode::PER_FACE;
+	}
+
+	chunkLoadScheduler.Generator = chunkGenerator;
+	chunkLoadScheduler.RegionStore = AChunk::RegionStore;
+	chunkLoadScheduler.SaveGeneratedChunks = CHUNK_SAVE_GENERATED;
+	chunkLoadScheduler.meshingMode = CHUNK_MESHING_MODE;
+	chunkLoadScheduler.MaxGenerateJobs = CHUNK_MAX_GENERATE_JOBS;
+	chunkLoadScheduler.MaxMeshJobs = CHUNK_MAX_MESH_JOBS;
+
+	AChunk::LodDistances = CHUNK_LOD_DISTANCES;
 
-	if (!PopulateBlockFunction)
-		PopulateBlockFunction = [this](int32 i, int32 j, int32 k) {
-		return BlueprintPopulateBlock(i, j, k);
-	};
+	chunkRemeshQueue.FastPathMilliseconds = CHUNK_EDIT_FAST_PATH_MS;
+	chunkUploadQueue.BudgetMilliseconds = CHUNK_UPLOAD_BUDGET_MS;
+	chunkCollisionQueue.CollisionDistance = CHUNK_COLLISION_DISTANCE;
+	chunkCollisionQueue.AddActor(this);
+
+	// The chunk under the player is created right away, the scheduler loads the rest by distance
+	int32 chunkX = floor(GetActorLocation().X / 1600.0f);
+	int32 chunkY = floor(GetActorLocation().Y / 1600.0f);
+	AChunk::PlayerChunkX = chunkX; AChunk::PlayerChunkY = chunkY;
 
-	// TODO: Use a heap to give priority to the chunks closest to the player
-	TArray<MeshData*> d = AChunk::GetMeshDataForChunk(0, 0, PopulateBlockFunction);
-	chunkRenderQueue.Enqueue(d);
+	FChunkBlockStorage blocks;
+	if (!AChunk::RegionStore || !AChunk::RegionStore->Load(chunkX, chunkY, blocks))
+	{
+		int32 dummy;
+		blocks = AChunk::GenerateChunkData(chunkX, chunkY, 16, 16, dummy, dummy, *chunkGenerator);
+		chunkGenerator->Decorate(chunkX, chunkY, blocks);
+	}
+
+	AChunk::CreateChunk(GetWorld(), AChunk::BuildChunk(chunkX, chunkY, MoveTemp(blocks), CHUNK_MESHING_MODE));
+}
+
+void AFPSCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+	// The cancels wait for the tasks still running, which release their MeshData and read the registries
+	chunkLoadScheduler.CancelAll();
+	chunkRemeshQueue.CancelAll();
+	chunkUploadQueue.Empty();
+	chunkCollisionQueue.CancelAll();
+	FMeshDataPool::Empty();
+	FChunkStats::DumpTimeToVisible();
+
+	// The edits of the chunks still loaded, the store waits for its saves when it's destroyed
+	AChunk::SaveModifiedChunks();
+	if (AChunk::RegionStore) AChunk::RegionStore->Flush();
+	chunkLoadScheduler.RegionStore.Reset();
+	AChunk::RegionStore.Reset();
 }
 
 // Called every frame
@@ -36,7 +103,7 @@ void AFPSCharacter::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	// ChunkMap handling
+	// ChunkRegistry handling
 	// TODO: Stop making these static magic numbers
 	// (1000,1000) -> (0,0); (-1000, -1000) -> (-1, -1); (-1601, -1601) -> (-2, -2); (1601, 1601) -> (1, 1)
 	int32 chunkX = floor(GetActorLocation().X / 1600.0f);
@@ -44,20 +111,47 @@ void AFPSCharacter::Tick(float DeltaTime)
 
 	if (LastChunkX != chunkX || LastChunkY != chunkY)
 	{
-		GEngine->AddOnScreenDebugMessage(-1, 20.0f, FColor::Yellow, FString::Printf(TEXT("Moved to new chunk %d %d"), chunkX, chunkY));
+		UE_LOG(LogTemp, Verbose, TEXT("Moved to new chunk %d %d"), chunkX, chunkY);
 
 		LastChunkX = chunkX; LastChunkY = chunkY;
 
-		AChunk::PlayerMovedToAnotherChunk(chunkX, chunkY, chunkRenderQueue, 
-			PopulateBlockFunction, CHUNK_RENDER_DISTANCE);
+		FVector forward = GetActorForwardVector();
+		AChunk::PlayerMovedToAnotherChunk(chunkX, chunkY, FVector2D(forward.X, forward.Y),
+			chunkLoadScheduler, CHUNK_RENDER_DISTANCE, CHUNK_UNLOAD_MARGIN);
+		chunkUploadQueue.SetCenter(chunkX, chunkY, CHUNK_RENDER_DISTANCE + CHUNK_UNLOAD_MARGIN);
 	}
 
+	chunkLoadScheduler.Tick(chunkRenderQueue);
 
-	if(!chunkRenderQueue.IsEmpty())
-	{
-		TArray<MeshData*> chunkData; chunkRenderQueue.Dequeue(chunkData);
+	// Block edits made this frame and neighbors that arrived are remeshed here
+	chunkRemeshQueue.Tick();
+
+	// New chunks are uploaded section by section, closest first, within CHUNK_UPLOAD_BUDGET_MS
+	TUniquePtr<FChunkBuildResult> chunk;
+	while (chunkRenderQueue.Dequeue(chunk))
+		chunkUploadQueue.Add(MoveTemp(chunk));
+
+	chunkUploadQueue.Tick(GetWorld(), GetActorLocation());
+
+	// Collision follows the player and the other collision actors, and picks up the edits
+	chunkCollisionQueue.Tick();
+
+	// Sections closed off from the camera by solid ground are hidden
+	FVector cameraLocation = GetActorLocation();
+	FRotator cameraRotation;
+	if (APlayerController* playerController = GetWorld()->GetFirstPlayerController())
+		playerController->GetPlayerViewPoint(cameraLocation, cameraRotation);
+	AChunk::UpdateSectionVisibility(cameraLocation, CHUNK_RENDER_DISTANCE + CHUNK_UNLOAD_MARGIN);
+
+	FChunkStats::SetCounters(chunkLoadScheduler.GetPendingCount(), chunkLoadScheduler.GetInFlightCount(), chunkUploadQueue.GetBacklog());
 
-		AChunk::CreateChunk(chunkData[0]->chunkI, chunkData[0]->chunkJ, GetWorld(), chunkData);
+	if (CHUNK_SHOW_UPLOAD_STATS && GEngine)
+	{
+		// A fixed key replaces the previous frame's message
+		const uint64 UploadStatsKey = 0x43484E4B;
+		GEngine->AddOnScreenDebugMessage(UploadStatsKey, 1.0f, FColor::Green, FString::Printf(TEXT("Chunk uploads: %d sections queued, %.2f ms, %d/%d sections visible, %d chunks colliding"),
+			chunkUploadQueue.GetBacklog(), chunkUploadQueue.GetLastTickMilliseconds(), AChunk::VisibleSectionCount, AChunk::LoadedSectionCount,
+			chunkCollisionQueue.GetCollidingChunkCount()));
 	}
 }
 
@@ -68,56 +162,80 @@ void AFPSCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputCompon
 
 }
 
+void AFPSCharacter::AddCollisionActor(AActor* actor)
+{
+	chunkCollisionQueue.AddActor(actor);
+}
+
+void AFPSCharacter::RemoveCollisionActor(AActor* actor)
+{
+	chunkCollisionQueue.RemoveActor(actor);
+}
+
 void AFPSCharacter::PrimaryFire()
 {
-	FHitResult hit = InstantShot();
-	AChunk* hitActor = Cast<AChunk>(hit.GetActor());
+	FVoxelHit hit;
+	if (!InstantShot(hit) || hit.bStartSolid) return;
 
-	if (hitActor)
-	{
-		FVector pointInside = hit.ImpactPoint + hit.ImpactNormal - hit.GetActor()->GetActorLocation();
+	// The new block goes against the face that was hit, which can be in the neighbor chunk
+	int32 i, j, k;
+	AChunk* chunk = FVoxelRaycast::FindBlock(hit.Block + hit.Normal, i, j, k);
 
-		hitActor->AddVoxel(pointInside, blockInHand);
-	}
+	if (chunk && i >= 0)
+		chunk->AddVoxel(FVector(k + 0.5f, j + 0.5f, i + 0.5f) * AChunk::BlockSize, blockInHand);
 }
 
 void AFPSCharacter::SecondaryFire()
 {
-	FHitResult hit = InstantShot();
-	AChunk* hitActor = Cast<AChunk>(hit.GetActor());
+	FVoxelHit hit;
+	if (!InstantShot(hit) || !hit.Chunk) return;
 
-	if (hitActor)
-	{
-		FVector pointInside = hit.ImpactPoint - hit.ImpactNormal - hit.GetActor()->GetActorLocation();
+	hit.Chunk->RemoveVoxel(FVector(hit.K + 0.5f, hit.J + 0.5f, hit.I + 0.5f) * AChunk::BlockSize);
+}
 
-		hitActor->RemoveVoxel(pointInside);
-	}
+void AFPSCharacter::CompareMeshingModes()
+{
+	int32 chunkX = floor(GetActorLocation().X / 1600.0f);
+	int32 chunkY = floor(GetActorLocation().Y / 1600.0f);
+
+	AChunk::LogMeshingComparison(chunkX, chunkY, *chunkGenerator);
+}
+
+void AFPSCharacter::BenchmarkMesher(int32 iterations)
+{
+	int32 chunkX = floor(GetActorLocation().X / 1600.0f);
+	int32 chunkY = floor(GetActorLocation().Y / 1600.0f);
+
+	AChunk::LogMesherBenchmark(chunkX, chunkY, *chunkGenerator, iterations);
+}
+
+void AFPSCharacter::BenchmarkRegionStore(int32 chunkCount)
+{
+	FChunkRegionStore::LogLoadBenchmark(*chunkGenerator, chunkCount);
+}
+
+void AFPSCharacter::DumpChunkStats()
+{
+	FChunkStats::DumpTimeToVisible();
 }
 
 void AFPSCharacter::ChangeBlockInHand(BlockType newBlockType)
 {
-	if (newBlockType > BlockType::AIR && newBlockType <= BlockType::LEAVES)
+	if (newBlockType != BlockType::AIR && FBlockRegistry::IsRegistered(newBlockType))
 		blockInHand = newBlockType;
 }
 
-FHitResult AFPSCharacter::InstantShot()
+bool AFPSCharacter::InstantShot(FVoxelHit& hit)
 {
 	FVector  rayLocation;
 	FRotator rayRotation;
-	FVector  endTrace;
 
 	APlayerController* const playerController = GetWorld()->GetFirstPlayerController();
-	if (playerController)
-	{
-		playerController->GetPlayerViewPoint(rayLocation, rayRotation);
-
-		endTrace = rayLocation + rayRotation.Vector() * weaponRange;
-	}
+	if (!playerController) return false;
 
-	FCollisionQueryParams traceParams(SCENE_QUERY_STAT(InstantShot), true, GetInstigator());
-	FHitResult hit(ForceInit);
-	GetWorld()->LineTraceSingleByChannel(hit, rayLocation, endTrace, ECC_Visibility, traceParams);
+	playerController->GetPlayerViewPoint(rayLocation, rayRotation);
 
-	return hit;
+	// Against the blocks themselves, sections that are still cooking their collision can be edited too
+	return FVoxelRaycast::Raycast(rayLocation, rayRotation.Vector(), weaponRange, hit);
 }
 
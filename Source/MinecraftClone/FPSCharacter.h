@@ -5,6 +5,12 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
 #include "Chunk.h"
+#include "ChunkLoadScheduler.h"
+#include "ChunkRemeshQueue.h"
+#include "ChunkUploadQueue.h"
+#include "ChunkCollisionQueue.h"
+#include "TerrainGenerator.h"
+#include "VoxelRaycast.h"
 #include "FPSCharacter.generated.h"
 
 UCLASS()
@@ -22,11 +28,99 @@ public:
 	UPROPERTY(EditAnywhere, Category = "ChunkGeneration")
 	int32 CHUNK_RENDER_DISTANCE { 10 };
 
+	// Chunks are unloaded once they are this many chunks past CHUNK_RENDER_DISTANCE
+	UPROPERTY(EditAnywhere, Category = "ChunkGeneration", meta = (ClampMin = "0"))
+	int32 CHUNK_UNLOAD_MARGIN { 2 };
+
+	UPROPERTY(EditAnywhere, Category = "ChunkGeneration")
+	MeshingMode CHUNK_MESHING_MODE { MeshingMode::PER_FACE };
+
+	// Chunks further than CHUNK_LOD_DISTANCES[n] chunks are meshed with cells of 2^(n+1) blocks, up to 8,
+	// with skirts along their walls. Empty meshes every chunk at full resolution
+	UPROPERTY(EditAnywhere, Category = "ChunkGeneration")
+	TArray<int32> CHUNK_LOD_DISTANCES { 6, 12, 20 };
+
+	// How many chunks can be generated (or loaded) and decorated at the same time
+	UPROPERTY(EditAnywhere, Category = "ChunkGeneration", meta = (ClampMin = "1"))
+	int32 CHUNK_MAX_GENERATE_JOBS { 8 };
+
+	// How many chunks can be meshed at the same time
+	UPROPERTY(EditAnywhere, Category = "ChunkGeneration", meta = (ClampMin = "1"))
+	int32 CHUNK_MAX_MESH_JOBS { 8 };
+
+	// How long the game thread can wait for the sections touched by a block edit, so the edit
+	// shows up on the same frame, 0 always leaves them for the next frame
+	UPROPERTY(EditAnywhere, Category = "ChunkGeneration", meta = (ClampMin = "0"))
+	float CHUNK_EDIT_FAST_PATH_MS { 2.0f };
+
+	// Chunks this many chunks or less away from the player, or an actor added with AddCollisionActor,
+	// get collision boxes, and lose them one chunk further
+	UPROPERTY(EditAnywhere, Category = "ChunkGeneration", meta = (ClampMin = "0"))
+	int32 CHUNK_COLLISION_DISTANCE { 2 };
+
+	// Game thread time per frame for uploading the sections of new chunks
+	UPROPERTY(EditAnywhere, Category = "ChunkGeneration", meta = (ClampMin = "0"))
+	float CHUNK_UPLOAD_BUDGET_MS { 4.0f };
+
+	// Shows the upload backlog and the time spent on it on screen
+	UPROPERTY(EditAnywhere, Category = "ChunkGeneration")
+	bool CHUNK_SHOW_UPLOAD_STATS { false };
+
+	// Rows of FBlockDefinition replacing the built in blocks of FBlockRegistry, by BlockType value.
+	// Chunks saved with other definitions keep their values, use another CHUNK_WORLD_NAME after changing them
+	UPROPERTY(EditAnywhere, Category = "ChunkGeneration")
+	UDataTable* CHUNK_BLOCK_TABLE = nullptr;
+
+	// Parameters of the native terrain generator
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ChunkGeneration")
+	FTerrainGenerationParams TERRAIN_PARAMS;
+
+	// Generate the chunks with BlueprintPopulateBlock instead of the native generator, block by
+	// block on the game thread, much slower
+	UPROPERTY(EditAnywhere, Category = "ChunkGeneration")
+	bool CHUNK_USE_BLUEPRINT_GENERATOR { false };
+
+	// Chunks are saved to region files in Saved/Worlds/CHUNK_WORLD_NAME and loaded from there
+	// instead of generated, use another name after changing TERRAIN_PARAMS
+	UPROPERTY(EditAnywhere, Category = "ChunkGeneration")
+	bool CHUNK_SAVE_WORLD { true };
+
+	UPROPERTY(EditAnywhere, Category = "ChunkGeneration")
+	FString CHUNK_WORLD_NAME { TEXT("World") };
+
+	// Save generated chunks too, not only edited ones, loading them is faster than generating them again
+	UPROPERTY(EditAnywhere, Category = "ChunkGeneration")
+	bool CHUNK_SAVE_GENERATED { true };
+
 	UFUNCTION(BlueprintImplementableEvent, Category = "ChunkGeneration")
 	BlockType BlueprintPopulateBlock(int32 i, int32 j, int32 k);
 
+	// If set before BeginPlay, chunks are generated with this instead, it has to be thread safe
 	TFunction<BlockType(int32 i, int32 j, int32 k)> PopulateBlockFunction = NULL;
 
+	// Logs the vertex, triangle and timing numbers of every meshing mode for the chunk the player is in
+	UFUNCTION(BlueprintCallable, Category = "ChunkGeneration")
+	void CompareMeshingModes();
+
+	// Times the bitmask and the per block face visibility on the chunk the player is in
+	UFUNCTION(Exec, BlueprintCallable, Category = "ChunkGeneration")
+	void BenchmarkMesher(int32 iterations = 20);
+
+	// Generates, saves and loads chunkCount chunks in a scratch directory and logs the chunks per second of each
+	UFUNCTION(Exec, BlueprintCallable, Category = "ChunkGeneration")
+	void BenchmarkRegionStore(int32 chunkCount = 256);
+
+	// Actors that need the chunks around them to collide, the player is always one
+	UFUNCTION(BlueprintCallable, Category = "ChunkGeneration")
+	void AddCollisionActor(AActor* actor);
+
+	UFUNCTION(BlueprintCallable, Category = "ChunkGeneration")
+	void RemoveCollisionActor(AActor* actor);
+
+	// Logs how long requested chunks took to show up and writes the histogram to Saved/Profiling
+	UFUNCTION(Exec, BlueprintCallable, Category = "ChunkGeneration")
+	void DumpChunkStats();
+
 	UFUNCTION(BlueprintCallable, Category = "Weapon")
 	void PrimaryFire();
 
@@ -36,12 +130,14 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Weapon")
 	void ChangeBlockInHand(BlockType newBlockType);
 
-	TQueue<TArray<MeshData*>> chunkRenderQueue;
+	TQueue<TUniquePtr<FChunkBuildResult>> chunkRenderQueue;
 
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
-	FHitResult InstantShot();
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	// The block under the crosshair within weaponRange
+	bool InstantShot(FVoxelHit& hit);
 
 public:	
 	BlockType blockInHand = BlockType::DIRT;
@@ -55,4 +151,14 @@ public:
 private:
 	int32 LastChunkX = 1000;
 	int32 LastChunkY = 1000;
+
+	FChunkLoadScheduler chunkLoadScheduler;
+
+	FChunkRemeshQueue chunkRemeshQueue;
+
+	FChunkUploadQueue chunkUploadQueue;
+
+	FChunkCollisionQueue chunkCollisionQueue;
+
+	TSharedPtr<const IChunkGenerator, ESPMode::ThreadSafe> chunkGenerator;
 };
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GradientNoise.h"
+
+FGradientNoise::FGradientNoise(int32 seed)
+{
+	for (int32 p = 0; p < 256; p++) mPermutation[p] = uint8(p);
+
+	// Fisher-Yates with a seeded stream, so the table only depends on the seed
+	FRandomStream random(seed);
+	for (int32 p = 255; p > 0; p--)
+	{
+		int32 other = random.RandRange(0, p);
+		Swap(mPermutation[p], mPermutation[other]);
+	}
+
+	for (int32 p = 0; p < 256; p++) mPermutation[p + 256] = mPermutation[p];
+}
+
+float FGradientNoise::Noise2D(float x, float y) const
+{
+	int32 xi = FMath::FloorToInt(x), yi = FMath::FloorToInt(y);
+	float xf = x - xi, yf = y - yi;
+	int32 X = xi & 255, Y = yi & 255;
+
+	uint8 aa = mPermutation[mPermutation[X] + Y], ab = mPermutation[mPermutation[X] + Y + 1];
+	uint8 ba = mPermutation[mPermutation[X + 1] + Y], bb = mPermutation[mPermutation[X + 1] + Y + 1];
+
+	float u = Fade(xf), v = Fade(yf);
+
+	float bottom = FMath::Lerp(Grad2D(aa, xf, yf), Grad2D(ba, xf - 1.0f, yf), u);
+	float top = FMath::Lerp(Grad2D(ab, xf, yf - 1.0f), Grad2D(bb, xf - 1.0f, yf - 1.0f), u);
+
+	return FMath::Lerp(bottom, top, v);
+}
+
+float FGradientNoise::Noise3D(float x, float y, float z) const
+{
+	int32 xi = FMath::FloorToInt(x), yi = FMath::FloorToInt(y), zi = FMath::FloorToInt(z);
+	float xf = x - xi, yf = y - yi, zf = z - zi;
+	int32 X = xi & 255, Y = yi & 255, Z = zi & 255;
+
+	int32 A = mPermutation[X] + Y, AA = mPermutation[A] + Z, AB = mPermutation[A + 1] + Z;
+	int32 B = mPermutation[X + 1] + Y, BA = mPermutation[B] + Z, BB = mPermutation[B + 1] + Z;
+
+	float u = Fade(xf), v = Fade(yf), w = Fade(zf);
+
+	float x1 = FMath::Lerp(Grad3D(mPermutation[AA], xf, yf, zf), Grad3D(mPermutation[BA], xf - 1.0f, yf, zf), u);
+	float x2 = FMath::Lerp(Grad3D(mPermutation[AB], xf, yf - 1.0f, zf), Grad3D(mPermutation[BB], xf - 1.0f, yf - 1.0f, zf), u);
+	float y1 = FMath::Lerp(x1, x2, v);
+
+	float x3 = FMath::Lerp(Grad3D(mPermutation[AA + 1], xf, yf, zf - 1.0f), Grad3D(mPermutation[BA + 1], xf - 1.0f, yf, zf - 1.0f), u);
+	float x4 = FMath::Lerp(Grad3D(mPermutation[AB + 1], xf, yf - 1.0f, zf - 1.0f), Grad3D(mPermutation[BB + 1], xf - 1.0f, yf - 1.0f, zf - 1.0f), u);
+	float y2 = FMath::Lerp(x3, x4, v);
+
+	return FMath::Lerp(y1, y2, w);
+}
+
+float FGradientNoise::Fractal2D(float x, float y, int32 octaves) const
+{
+	float sum = 0.0f, amplitude = 1.0f, totalAmplitude = 0.0f;
+	for (int32 octave = 0; octave < octaves; octave++)
+	{
+		sum += Noise2D(x, y) * amplitude;
+		totalAmplitude += amplitude;
+
+		x *= 2.0f; y *= 2.0f;
+		amplitude *= 0.5f;
+	}
+
+	return totalAmplitude > 0.0f ? sum / totalAmplitude : 0.0f;
+}
+
+void FGradientNoise::Fractal2DRow(float x, float y, float step, int32 count, int32 octaves, float* out) const
+{
+	// Octave by octave over the whole row, so each pass is a tight loop over independent points
+	for (int32 p = 0; p < count; p++) out[p] = 0.0f;
+
+	float frequency = 1.0f, amplitude = 1.0f, totalAmplitude = 0.0f;
+	for (int32 octave = 0; octave < octaves; octave++)
+	{
+		for (int32 p = 0; p < count; p++)
+			out[p] += Noise2D((x + p * step) * frequency, y * frequency) * amplitude;
+
+		totalAmplitude += amplitude;
+		frequency *= 2.0f;
+		amplitude *= 0.5f;
+	}
+
+	if (totalAmplitude <= 0.0f) return;
+	for (int32 p = 0; p < count; p++) out[p] /= totalAmplitude;
+}
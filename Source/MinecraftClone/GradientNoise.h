@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Seeded gradient (Perlin) noise. The same seed always gives the same values and every method is
+// const, so one instance can be shared by any number of worker threads.
+// Values are roughly in [-1, 1].
+class MINECRAFTCLONE_API FGradientNoise
+{
+public:
+	explicit FGradientNoise(int32 seed);
+
+	float Noise2D(float x, float y) const;
+
+	float Noise3D(float x, float y, float z) const;
+
+	// Sum of octaves of Noise2D, each one with twice the frequency and half the amplitude,
+	// divided by the total amplitude so it stays in [-1, 1]
+	float Fractal2D(float x, float y, int32 octaves) const;
+
+	// Fractal2D for count points starting at (x, y) and moving step along x, written to out
+	void Fractal2DRow(float x, float y, float step, int32 count, int32 octaves, float* out) const;
+
+private:
+	// Shuffled 0..255, repeated twice so lookups never wrap
+	uint8 mPermutation[512];
+
+	static FORCEINLINE float Fade(float t) { return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f); }
+
+	static FORCEINLINE float Grad2D(uint8 hash, float x, float y)
+	{
+		// 8 directions, the diagonals and the axes
+		switch (hash & 7)
+		{
+		case 0: return x + y;
+		case 1: return -x + y;
+		case 2: return x - y;
+		case 3: return -x - y;
+		case 4: return x;
+		case 5: return -x;
+		case 6: return y;
+		default: return -y;
+		}
+	}
+
+	static FORCEINLINE float Grad3D(uint8 hash, float x, float y, float z)
+	{
+		// The 12 edges of a cube, with 4 of them repeated to have 16 cases
+		int32 h = hash & 15;
+		float u = h < 8 ? x : y;
+		float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+		return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+	}
+};
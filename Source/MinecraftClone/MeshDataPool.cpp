@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MeshDataPool.h"
+#include "Chunk.h"
+
+TLockFreePointerListUnordered<MeshData, PLATFORM_CACHE_LINE_SIZE> FMeshDataPool::mFree;
+std::atomic<int32> FMeshDataPool::mPooled{ 0 };
+std::atomic<int64> FMeshDataPool::mPooledBytes{ 0 };
+std::atomic<int32> FMeshDataPool::mAllocations{ 0 };
+std::atomic<int32> FMeshDataPool::mReuses{ 0 };
+std::atomic<int32> FMeshDataPool::mGrowths{ 0 };
+
+MeshData* FMeshDataPool::Acquire()
+{
+	if (MeshData* data = mFree.Pop())
+	{
+		mPooled--;
+		mPooledBytes -= data->quads.GetAllocatedSize();
+		mReuses++;
+		return data;
+	}
+
+	mAllocations++;
+	return new MeshData();
+}
+
+void FMeshDataPool::Release(MeshData* data)
+{
+	if (!data) return;
+
+	// The count can go a bit over with threads releasing at once, it's only a bound
+	if (mPooled >= MaxPooled)
+	{
+		delete(data);
+		return;
+	}
+
+	data->Reset();
+	if (data->quads.Max() > MaxPooledQuads) data->quads.Empty();
+
+	mPooledBytes += data->quads.GetAllocatedSize();
+	mPooled++;
+	mFree.Push(data);
+}
+
+void FMeshDataPool::Empty()
+{
+	while (MeshData* data = mFree.Pop())
+	{
+		mPooled--;
+		mPooledBytes -= data->quads.GetAllocatedSize();
+		delete(data);
+	}
+}
+
+FMeshDataPool::FCounters FMeshDataPool::TakeCounters()
+{
+	FCounters counters;
+	counters.Allocations = mAllocations.exchange(0);
+	counters.Reuses = mReuses.exchange(0);
+	counters.Growths = mGrowths.exchange(0);
+	counters.Pooled = FMath::Max(mPooled.load(), 0);
+	counters.PooledBytes = SIZE_T(FMath::Max<int64>(mPooledBytes.load(), 0));
+
+	return counters;
+}
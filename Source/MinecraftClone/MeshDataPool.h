@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LockFreeList.h"
+#include <atomic>
+
+class MeshData;
+
+// MeshData objects recycled between sections. The meshing workers take them and the game thread gives
+// them back once their section is uploaded, so they go through one lock free list shared by every
+// thread, a per worker list would empty on the workers and fill up on the game thread. A recycled
+// MeshData keeps the allocation of its quads, in steady state meshing a section allocates nothing.
+// The counters are read and cleared once per frame by FChunkStats::SetCounters.
+class MINECRAFTCLONE_API FMeshDataPool
+{
+public:
+	// MeshData kept around at most, the rest are deleted
+	static const int32 MaxPooled = 1024;
+
+	// Quads a pooled MeshData keeps room for at most, sections that needed more give their buffer back
+	static const int32 MaxPooledQuads = 4096;
+
+	// A reset MeshData, from the pool if there's one. Any thread
+	static MeshData* Acquire();
+
+	// Resets the MeshData and puts it back in the pool, null is ignored. Any thread
+	static void Release(MeshData* data);
+
+	// For meshing functions, a section whose quads had to grow past the capacity they started with
+	static void CountGrowth() { mGrowths++; }
+
+	// Deletes the pooled MeshData, the ones still out are deleted when they're released
+	static void Empty();
+
+	struct FCounters
+	{
+		// Since the last TakeCounters
+		int32 Allocations = 0;
+		int32 Reuses = 0;
+		int32 Growths = 0;
+
+		// Right now
+		int32 Pooled = 0;
+		SIZE_T PooledBytes = 0;
+	};
+
+	// The counters since the last call, which are cleared
+	static FCounters TakeCounters();
+
+private:
+	static TLockFreePointerListUnordered<MeshData, PLATFORM_CACHE_LINE_SIZE> mFree;
+	static std::atomic<int32> mPooled;
+	static std::atomic<int64> mPooledBytes;
+
+	static std::atomic<int32> mAllocations;
+	static std::atomic<int32> mReuses;
+	static std::atomic<int32> mGrowths;
+};
@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SectionFaceMasks.h"
+#include "Chunk.h"
+
+void FSectionFaceMasks::Build(const FChunkVolumeView& volume, int32 sectionID)
+{
+	const FChunkBlockStorage& blocks = volume.GetBlocks();
+	const FChunkBorders* borders = volume.GetBorders();
+	const int32 side = blocks.GetSectionSide();
+	const int32 height = blocks.GetSectionCount() * side;
+	const int32 rows = side * side;
+	const int32 paddedSide = side + 2;
+	check(side <= MaxSectionSide);
+
+	mSectionSide = side;
+	mBlocks.SetNumUninitialized(rows * side);
+	mOpaque.SetNumUninitialized(paddedSide * paddedSide);
+	mFilled.SetNumUninitialized(rows);
+	mAny.SetNumUninitialized(rows);
+	for (int32 d = 0; d < MeshData::Direction::SIZE; d++)
+		mFaces[d].SetNumUninitialized(rows);
+
+	// Out of the world blocks count as opaque (no faces at the top and bottom), blocks of missing
+	// neighbor chunks count as air (faces on the walls are emitted), same as CheckIfNeighboorIsAir
+	auto opaqueRowAt = [&](int32 i, int32 j) -> uint32
+	{
+		uint32 row = 0;
+		for (int32 k = 0; k < side; k++)
+			row |= uint32(FBlockRegistry::IsOpaque(blocks.Get(i, j, k))) << (k + 1);
+		return row;
+	};
+
+	auto wallBit = [&](MeshData::Direction direction, int32 i, int32 along) -> uint32
+	{
+		if (!borders || !borders->IsLoaded(direction)) return 0;
+		return FBlockRegistry::IsOpaque(borders->Get(direction, i, along, side));
+	};
+
+	const int32 baseI = sectionID * side;
+	blocks.GetSection(sectionID, mBlocks.GetData());
+
+	for (int32 paddedI = 0; paddedI < paddedSide; paddedI++)
+	{
+		int32 i = baseI + paddedI - 1;
+		bool outOfWorld = i < 0 || i >= height;
+
+		for (int32 paddedJ = 0; paddedJ < paddedSide; paddedJ++)
+		{
+			int32 j = paddedJ - 1;
+			uint32& row = OpaqueRow(paddedI, paddedJ);
+
+			if (outOfWorld) { row = ~0u; continue; }
+
+			// Only the rows right next to the section are read, the corners never are
+			bool edgeI = paddedI == 0 || paddedI == paddedSide - 1;
+			bool edgeJ = j < 0 || j >= side;
+			if (edgeI && edgeJ) { row = 0; continue; }
+
+			if (edgeJ)
+			{
+				MeshData::Direction wall = j < 0 ? MeshData::FORWARD : MeshData::BACK;
+				row = 0;
+				for (int32 k = 0; k < side; k++)
+					row |= wallBit(wall, i, k) << (k + 1);
+				continue;
+			}
+
+			if (edgeI)
+			{
+				row = opaqueRowAt(i, j);
+				continue;
+			}
+
+			const BlockType* line = mBlocks.GetData() + ((paddedI - 1) * side + j) * side;
+			uint32 filled = 0;
+			row = 0;
+			for (int32 k = 0; k < side; k++)
+			{
+				filled |= uint32(line[k] != BlockType::AIR) << k;
+				row |= uint32(FBlockRegistry::IsOpaque(line[k])) << (k + 1);
+			}
+			mFilled[(paddedI - 1) * side + j] = filled;
+
+			row |= wallBit(MeshData::LEFT, i, j);
+			row |= wallBit(MeshData::RIGHT, i, j) << (side + 1);
+		}
+	}
+
+	// The whole section at once, every row is independent so this vectorizes
+	for (int32 localI = 0; localI < side; localI++)
+	{
+		const uint32* below = &OpaqueRow(localI, 1);
+		const uint32* current = &OpaqueRow(localI + 1, 1);
+		const uint32* above = &OpaqueRow(localI + 2, 1);
+		const int32 rowOffset = localI * side;
+
+		for (int32 j = 0; j < side; j++)
+		{
+			uint32 center = mFilled[rowOffset + j];
+
+			uint32 up = center & ~(above[j] >> 1);
+			uint32 down = center & ~(below[j] >> 1);
+			uint32 left = center & ~current[j];
+			uint32 right = center & ~(current[j] >> 2);
+			uint32 forward = center & ~(current[j - 1] >> 1);
+			uint32 back = center & ~(current[j + 1] >> 1);
+
+			mFaces[MeshData::UP][rowOffset + j] = up;
+			mFaces[MeshData::DOWN][rowOffset + j] = down;
+			mFaces[MeshData::LEFT][rowOffset + j] = left;
+			mFaces[MeshData::RIGHT][rowOffset + j] = right;
+			mFaces[MeshData::FORWARD][rowOffset + j] = forward;
+			mFaces[MeshData::BACK][rowOffset + j] = back;
+			mAny[rowOffset + j] = up | down | left | right | forward | back;
+		}
+	}
+}
+
+int32 FSectionFaceMasks::CountFaces() const
+{
+	int32 count = 0;
+	for (int32 d = 0; d < MeshData::Direction::SIZE; d++)
+		for (uint32 row : mFaces[d])
+			count += FPlatformMath::CountBits(row);
+
+	return count;
+}
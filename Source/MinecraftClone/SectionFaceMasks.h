@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+enum class BlockType : uint8;
+class FChunkVolumeView;
+
+// Visible faces of a section as bitmasks. There's one uint32 per (i, j) row of the section for each
+// MeshData::Direction, with bit k set when the block at k has that face exposed.
+// Build decodes the section into rows of its non AIR blocks, and the section and its neighbors into
+// padded rows of opaque blocks (see FBlockRegistry), then gets the six face masks with shifts and ANDs
+// on whole rows, giving the same faces as calling CheckIfNeighboorIsAir per block.
+class MINECRAFTCLONE_API FSectionFaceMasks
+{
+public:
+	// Rows keep one bit of padding on each side, so a section can be at most 30 blocks wide
+	static const int32 MaxSectionSide = 30;
+
+	void Build(const FChunkVolumeView& volume, int32 sectionID);
+
+	// Rows are indexed by localI * sectionSide + j
+	FORCEINLINE uint32 GetRow(int32 direction, int32 localI, int32 j) const
+	{
+		return mFaces[direction][localI * mSectionSide + j];
+	}
+
+	FORCEINLINE bool IsVisible(int32 direction, int32 localI, int32 j, int32 k) const
+	{
+		return (GetRow(direction, localI, j) >> k) & 1;
+	}
+
+	// Faces of any direction in the row
+	FORCEINLINE uint32 GetAnyRow(int32 localI, int32 j) const
+	{
+		return mAny[localI * mSectionSide + j];
+	}
+
+	// The blocks of the section in GetPositionInTArray order, decoded while building
+	const TArray<BlockType>& GetBlocks() const { return mBlocks; }
+
+	// Total visible faces, handy to reserve the mesh arrays
+	int32 CountFaces() const;
+
+private:
+	int32 mSectionSide = 0;
+
+	TArray<uint32> mFaces[6];
+	TArray<uint32> mAny;
+
+	// Blocks of the section that have faces at all, one row per (i, j) like mAny
+	TArray<uint32> mFilled;
+
+	// Opacity of the section and the layer of blocks around it, (side + 2)^2 rows with bit k + 1 for block k
+	TArray<uint32> mOpaque;
+
+	TArray<BlockType> mBlocks;
+
+	FORCEINLINE uint32& OpaqueRow(int32 paddedI, int32 paddedJ)
+	{
+		return mOpaque[paddedI * (mSectionSide + 2) + paddedJ];
+	}
+};
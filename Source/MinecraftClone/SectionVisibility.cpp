@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SectionVisibility.h"
+#include "Chunk.h"
+
+// Chunk, section and block offsets of each MeshData::Direction, in ijk order for the blocks
+static const int32 DIRECTION_STEPS[6][3] = { {1, 0, 0}, {-1, 0, 0}, {0, 0, -1}, {0, 0, 1}, {0, -1, 0}, {0, 1, 0} };
+
+uint16 FSectionConnectivity::Compute(const FChunkBlockStorage& blocks, int32 section)
+{
+	if (blocks.IsSectionEmpty(section)) return All;
+	if (blocks.IsSectionOpaque(section)) return 0;
+
+	int32 side = blocks.GetSectionSide(), count = side * side * side;
+
+	TArray<BlockType, TInlineAllocator<1024>> sectionBlocks;
+	sectionBlocks.SetNumUninitialized(count);
+	blocks.GetSection(section, sectionBlocks.GetData());
+
+	TBitArray<TInlineAllocator<128>> visited(false, count);
+	TArray<int32, TInlineAllocator<256>> stack;
+
+	uint16 connectivity = 0;
+	for (int32 start = 0; start < count && connectivity != All; start++)
+	{
+		if (visited[start] || FBlockRegistry::IsOpaque(sectionBlocks[start])) continue;
+
+		// Faces touched by this open region, which can be seen through leaves too
+		uint8 faces = 0;
+		visited[start] = true;
+		stack.Add(start);
+
+		while (stack.Num() > 0)
+		{
+			int32 b = stack.Pop(EAllowShrinking::No);
+			int32 i = b / (side * side), j = (b / side) % side, k = b % side;
+
+			if (i == side - 1) faces |= 1 << MeshData::UP;
+			if (i == 0) faces |= 1 << MeshData::DOWN;
+			if (k == 0) faces |= 1 << MeshData::LEFT;
+			if (k == side - 1) faces |= 1 << MeshData::RIGHT;
+			if (j == 0) faces |= 1 << MeshData::FORWARD;
+			if (j == side - 1) faces |= 1 << MeshData::BACK;
+
+			for (int32 d = 0; d < 6; d++)
+			{
+				int32 ni = i + DIRECTION_STEPS[d][0], nj = j + DIRECTION_STEPS[d][1], nk = k + DIRECTION_STEPS[d][2];
+				if (ni < 0 || ni >= side || nj < 0 || nj >= side || nk < 0 || nk >= side) continue;
+
+				int32 neighbor = (ni * side + nj) * side + nk;
+				if (visited[neighbor] || FBlockRegistry::IsOpaque(sectionBlocks[neighbor])) continue;
+
+				visited[neighbor] = true;
+				stack.Add(neighbor);
+			}
+		}
+
+		for (int32 a = 0; a < 6; a++)
+			for (int32 b = a + 1; b < 6; b++)
+				if ((faces & (1 << a)) && (faces & (1 << b))) connectivity |= 1u << GetPairBit(a, b);
+	}
+
+	return connectivity;
+}
+
+void FSectionVisibilityGraph::SetSection(int32 ChunkX, int32 ChunkY, int32 section, int32 sectionCount, uint16 connectivity)
+{
+	FChunkGraph& chunk = mChunks.FindOrAdd(GetKey(ChunkX, ChunkY));
+	chunk.SectionCount = sectionCount;
+
+	if ((chunk.KnownSections & (1u << section)) && chunk.Connectivity[section] == connectivity) return;
+
+	chunk.Connectivity[section] = connectivity;
+	chunk.KnownSections |= 1u << section;
+	mVersion++;
+}
+
+void FSectionVisibilityGraph::RemoveChunk(int32 ChunkX, int32 ChunkY)
+{
+	if (mChunks.Remove(GetKey(ChunkX, ChunkY)) > 0) mVersion++;
+}
+
+void FSectionVisibilityGraph::Empty()
+{
+	mChunks.Empty();
+	mVersion++;
+}
+
+bool FSectionVisibilityGraph::FindVisibleSections(int32 cameraChunkX, int32 cameraChunkY, int32 cameraSection,
+	int32 maxDistance, TMap<int64, uint32>& visibleSections) const
+{
+	visibleSections.Reset();
+
+	const FChunkGraph* cameraChunk = mChunks.Find(GetKey(cameraChunkX, cameraChunkY));
+	if (!cameraChunk || cameraSection < 0 || cameraSection >= cameraChunk->SectionCount) return false;
+
+	struct FNode
+	{
+		int32 ChunkX;
+		int32 ChunkY;
+		int32 Section;
+		// Face it was entered through, -1 for the camera section
+		int32 EnteredFrom;
+		// Directions taken to get here
+		uint8 Directions;
+	};
+
+	TArray<FNode> queue;
+	queue.Add(FNode{ cameraChunkX, cameraChunkY, cameraSection, -1, 0 });
+	visibleSections.Add(GetKey(cameraChunkX, cameraChunkY), 1u << cameraSection);
+
+	for (int32 n = 0; n < queue.Num(); n++)
+	{
+		FNode node = queue[n];
+		const FChunkGraph& chunk = mChunks.FindChecked(GetKey(node.ChunkX, node.ChunkY));
+
+		for (int32 d = 0; d < 6; d++)
+		{
+			// Never back towards where the search came from
+			if (node.Directions & (1 << (d ^ 1))) continue;
+
+			// The camera sees out of its own section through any face
+			if (node.EnteredFrom >= 0 && (d == node.EnteredFrom || !FSectionConnectivity::AreConnected(chunk.Connectivity[node.Section], node.EnteredFrom, d)))
+				continue;
+
+			// DIRECTION_STEPS is ijk, i is the section, k goes along X and j along Y
+			int32 nextX = node.ChunkX + DIRECTION_STEPS[d][2], nextY = node.ChunkY + DIRECTION_STEPS[d][1];
+			int32 nextSection = node.Section + DIRECTION_STEPS[d][0];
+			if (FMath::Abs(nextX - cameraChunkX) > maxDistance || FMath::Abs(nextY - cameraChunkY) > maxDistance) continue;
+
+			const FChunkGraph* next = mChunks.Find(GetKey(nextX, nextY));
+			if (!next || nextSection < 0 || nextSection >= next->SectionCount || !(next->KnownSections & (1u << nextSection))) continue;
+
+			uint32& visible = visibleSections.FindOrAdd(GetKey(nextX, nextY));
+			if (visible & (1u << nextSection)) continue;
+
+			visible |= 1u << nextSection;
+			queue.Add(FNode{ nextX, nextY, nextSection, d ^ 1, uint8(node.Directions | (1 << d)) });
+		}
+	}
+
+	return true;
+}
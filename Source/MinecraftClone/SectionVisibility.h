@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FChunkBlockStorage;
+
+// Which faces of a section can see each other through the section, one bit per pair of faces
+// (in MeshData::Direction order), 15 bits in total. Two faces are connected when a region of
+// blocks that aren't opaque (see FBlockRegistry) touches both of them.
+class MINECRAFTCLONE_API FSectionConnectivity
+{
+public:
+	static const uint16 All = 0x7FFF;
+
+	// Flood fills the blocks of the section that aren't opaque
+	static uint16 Compute(const FChunkBlockStorage& blocks, int32 section);
+
+	static FORCEINLINE int32 GetPairBit(int32 faceA, int32 faceB)
+	{
+		if (faceA > faceB) Swap(faceA, faceB);
+		return faceA * (11 - faceA) / 2 + faceB - faceA - 1;
+	}
+
+	static FORCEINLINE bool AreConnected(uint16 connectivity, int32 faceA, int32 faceB)
+	{
+		return (connectivity & (1u << GetPairBit(faceA, faceB))) != 0;
+	}
+};
+
+// The connectivity of every section of the loaded chunks, and which of them the camera can possibly
+// see through the others. Doesn't know about actors or meshes, so it can be driven from anywhere.
+// The visible sections come from a BFS starting at the camera section: a section is entered through
+// a face and left through another one connected to it, and never in the direction opposite to one
+// already taken, so the search doesn't wrap around walls. Sections with no connected faces stop it,
+// so a cave only sees the sections that open into it.
+class MINECRAFTCLONE_API FSectionVisibilityGraph
+{
+public:
+	void SetSection(int32 ChunkX, int32 ChunkY, int32 section, int32 sectionCount, uint16 connectivity);
+
+	void RemoveChunk(int32 ChunkX, int32 ChunkY);
+
+	void Empty();
+
+	// Sections reached from the camera section, at most maxDistance chunks away on either axis.
+	// False if the camera isn't in a known section, everything should be visible then
+	bool FindVisibleSections(int32 cameraChunkX, int32 cameraChunkY, int32 cameraSection, int32 maxDistance,
+		TMap<int64, uint32>& visibleSections) const;
+
+	// Bumped every time a section changes, to know when the visible sections need to be searched again
+	uint32 GetVersion() const { return mVersion; }
+
+	static int64 GetKey(int32 ChunkX, int32 ChunkY) { return (int64(ChunkX) << 32) | uint32(ChunkY); }
+
+private:
+	struct FChunkGraph
+	{
+		uint16 Connectivity[32];
+		int32 SectionCount = 0;
+		// Bit s is set once section s got its connectivity, sections not meshed yet block the search
+		uint32 KnownSections = 0;
+	};
+
+	TMap<int64, FChunkGraph> mChunks;
+	uint32 mVersion = 0;
+};
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Misc/AutomationTest.h"
+#include "SectionVisibility.h"
+#include "Chunk.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+static const int32 TEST_SIDE = 16;
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSectionConnectivityTest, "MinecraftClone.SectionVisibility.Connectivity",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::CommandletContext | EAutomationTestFlags::ProductFilter)
+
+bool FSectionConnectivityTest::RunTest(const FString& Parameters)
+{
+	FChunkBlockStorage solid(TEST_SIDE, 1, BlockType::STONE);
+	TestEqual(TEXT("A solid section connects no faces"), FSectionConnectivity::Compute(solid, 0), uint16(0));
+
+	FChunkBlockStorage empty(TEST_SIDE, 1, BlockType::AIR);
+	TestEqual(TEXT("An empty section connects every face"), FSectionConnectivity::Compute(empty, 0), FSectionConnectivity::All);
+
+	// A wall across the section at k = 8, LEFT is on one side and RIGHT on the other
+	FChunkBlockStorage split(TEST_SIDE, 1, BlockType::AIR);
+	for (int32 i = 0; i < TEST_SIDE; i++)
+		for (int32 j = 0; j < TEST_SIDE; j++)
+			split.Set(i, j, 8, BlockType::STONE);
+
+	uint16 connectivity = FSectionConnectivity::Compute(split, 0);
+	TestFalse(TEXT("The wall separates LEFT from RIGHT"), FSectionConnectivity::AreConnected(connectivity, MeshData::LEFT, MeshData::RIGHT));
+	TestTrue(TEXT("LEFT sees UP"), FSectionConnectivity::AreConnected(connectivity, MeshData::LEFT, MeshData::UP));
+	TestTrue(TEXT("RIGHT sees DOWN"), FSectionConnectivity::AreConnected(connectivity, MeshData::RIGHT, MeshData::DOWN));
+	TestTrue(TEXT("UP sees DOWN along the wall"), FSectionConnectivity::AreConnected(connectivity, MeshData::UP, MeshData::DOWN));
+	TestTrue(TEXT("FORWARD sees BACK along the wall"), FSectionConnectivity::AreConnected(connectivity, MeshData::FORWARD, MeshData::BACK));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSectionVisibilityGraphTest, "MinecraftClone.SectionVisibility.Graph",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::CommandletContext | EAutomationTestFlags::ProductFilter)
+
+bool FSectionVisibilityGraphTest::RunTest(const FString& Parameters)
+{
+	// Two chunks of 4 sections side by side, open air on top of a solid layer. Below the solid layer
+	// of chunk (0, 0) there's a cave, sealed by the solid layer above it and the solid section of (1, 0)
+	const int32 sectionCount = 4;
+	FSectionVisibilityGraph graph;
+	for (int32 chunkX = 0; chunkX <= 1; chunkX++)
+	{
+		graph.SetSection(chunkX, 0, 3, sectionCount, FSectionConnectivity::All);
+		graph.SetSection(chunkX, 0, 2, sectionCount, FSectionConnectivity::All);
+	}
+	graph.SetSection(0, 0, 1, sectionCount, 0);
+	graph.SetSection(0, 0, 0, sectionCount, FSectionConnectivity::All);
+	graph.SetSection(1, 0, 1, sectionCount, FSectionConnectivity::All);
+	graph.SetSection(1, 0, 0, sectionCount, 0);
+
+	TMap<int64, uint32> visible;
+	TestTrue(TEXT("The camera section is known"), graph.FindVisibleSections(0, 0, 2, 1, visible));
+
+	uint32 origin = visible.FindRef(FSectionVisibilityGraph::GetKey(0, 0));
+	uint32 neighbor = visible.FindRef(FSectionVisibilityGraph::GetKey(1, 0));
+
+	TestTrue(TEXT("The section above the camera is visible"), (origin & (1u << 3)) != 0);
+	TestTrue(TEXT("The solid section under the camera is visible"), (origin & (1u << 1)) != 0);
+	TestFalse(TEXT("The sealed cave is hidden"), (origin & (1u << 0)) != 0);
+	TestTrue(TEXT("The neighbor section next to the camera is visible"), (neighbor & (1u << 2)) != 0);
+	TestTrue(TEXT("The neighbor section reached through air is visible"), (neighbor & (1u << 1)) != 0);
+
+	TestFalse(TEXT("An unknown camera section finds nothing"), graph.FindVisibleSections(5, 5, 0, 1, visible));
+
+	return true;
+}
+
+#endif
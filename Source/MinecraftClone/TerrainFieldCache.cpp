@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TerrainFieldCache.h"
+
+FTerrainFieldCache::FTerrainFieldCache(int32 maxTiles, FComputeTile computeTile) :
+	mComputeTile(MoveTemp(computeTile)),
+	mTiles(FMath::Max(1, maxTiles))
+{
+}
+
+void FTerrainFieldCache::GetColumns(int32 worldX, int32 worldY, int32 sizeX, int32 sizeY, FTerrainColumn* out) const
+{
+	// Usually a single tile, a rectangle only straddles tiles when it isn't aligned to them
+	int32 firstTileX = FMath::FloorToInt(float(worldX) / TileSide), lastTileX = FMath::FloorToInt(float(worldX + sizeX - 1) / TileSide);
+	int32 firstTileY = FMath::FloorToInt(float(worldY) / TileSide), lastTileY = FMath::FloorToInt(float(worldY + sizeY - 1) / TileSide);
+
+	for (int32 tileY = firstTileY; tileY <= lastTileY; tileY++)
+	{
+		for (int32 tileX = firstTileX; tileX <= lastTileX; tileX++)
+		{
+			FTilePtr tile = GetTile(tileX, tileY);
+
+			int32 fromX = FMath::Max(worldX, tileX * TileSide), toX = FMath::Min(worldX + sizeX, (tileX + 1) * TileSide);
+			int32 fromY = FMath::Max(worldY, tileY * TileSide), toY = FMath::Min(worldY + sizeY, (tileY + 1) * TileSide);
+
+			for (int32 y = fromY; y < toY; y++)
+			{
+				const FTerrainColumn* source = tile->GetData() + (y - tileY * TileSide) * TileSide + (fromX - tileX * TileSide);
+				FMemory::Memcpy(out + (y - worldY) * sizeX + (fromX - worldX), source, (toX - fromX) * sizeof(FTerrainColumn));
+			}
+		}
+	}
+}
+
+void FTerrainFieldCache::Empty()
+{
+	FScopeLock lock(&mLock);
+	mTiles.Empty(mTiles.Max());
+}
+
+int32 FTerrainFieldCache::Num() const
+{
+	FScopeLock lock(&mLock);
+	return mTiles.Num();
+}
+
+FTerrainFieldCache::FTilePtr FTerrainFieldCache::GetTile(int32 tileX, int32 tileY) const
+{
+	uint64 key = GetKey(tileX, tileY);
+
+	{
+		FScopeLock lock(&mLock);
+		if (const FTilePtr* cached = mTiles.FindAndTouch(key))
+			return *cached;
+	}
+
+	TSharedPtr<TArray<FTerrainColumn>, ESPMode::ThreadSafe> tile = MakeShared<TArray<FTerrainColumn>, ESPMode::ThreadSafe>();
+	tile->SetNumUninitialized(TileSide * TileSide);
+	mComputeTile(tileX * TileSide, tileY * TileSide, TileSide, tile->GetData());
+
+	FScopeLock lock(&mLock);
+
+	// Someone else computed it meanwhile, keep theirs so every job sees the same tile
+	if (const FTilePtr* cached = mTiles.FindAndTouch(key))
+		return *cached;
+
+	mTiles.Add(key, tile);
+	return tile;
+}
@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LruCache.h"
+
+// The 2D generation fields of one column of blocks, they only depend on the world X and Y of the column
+struct FTerrainColumn
+{
+	// Height of the top solid block
+	int32 Height;
+
+	// Low frequency climate fields in [-1, 1] for the biomes
+	float Temperature;
+	float Humidity;
+};
+
+// Thread safe cache of FTerrainColumn tiles of TileSide x TileSide columns, shared by all the chunk
+// jobs of a generator. A tile is computed once by whichever job needs it first and kept until it's the
+// least recently used one and the cache is full, so the chunks of the same region only look the
+// columns up. Two jobs missing the same tile at the same time both compute it, the second one is
+// thrown away, that's cheaper than making one of them wait.
+class MINECRAFTCLONE_API FTerrainFieldCache
+{
+public:
+	// 4x4 chunks of 16 blocks
+	static const int32 TileSide = 64;
+
+	typedef TFunction<void(int32 worldX, int32 worldY, int32 side, FTerrainColumn* out)> FComputeTile;
+
+	// computeTile fills side x side columns starting at world column (worldX, worldY), indexed by
+	// y * side + x. It's called from the worker threads without any lock held.
+	FTerrainFieldCache(int32 maxTiles, FComputeTile computeTile);
+
+	// Copies the columns of the sizeX x sizeY rectangle starting at world column (worldX, worldY) to out,
+	// indexed by y * sizeX + x, computing the tiles that aren't cached
+	void GetColumns(int32 worldX, int32 worldY, int32 sizeX, int32 sizeY, FTerrainColumn* out) const;
+
+	void Empty();
+
+	int32 Num() const;
+
+private:
+	typedef TSharedPtr<const TArray<FTerrainColumn>, ESPMode::ThreadSafe> FTilePtr;
+
+	FComputeTile mComputeTile;
+
+	// Tiles are handed out as shared pointers so an evicted tile stays alive for the jobs still reading it
+	mutable TLruCache<uint64, FTilePtr> mTiles;
+	mutable FCriticalSection mLock;
+
+	FTilePtr GetTile(int32 tileX, int32 tileY) const;
+
+	static uint64 GetKey(int32 tileX, int32 tileY) { return (uint64(uint32(tileX)) << 32) | uint32(tileY); }
+};
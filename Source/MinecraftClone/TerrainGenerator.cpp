@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TerrainGenerator.h"
+
+void IChunkGenerator::GenerateChunk(int32 ChunkX, int32 ChunkY, FChunkBlockStorage& blocks) const
+{
+	int32 sectionSide = blocks.GetSectionSide();
+
+	TArray<BlockType> sectionBlocks;
+	sectionBlocks.SetNumUninitialized(sectionSide * sectionSide * sectionSide);
+
+	for (int32 section = 0; section < blocks.GetSectionCount(); section++)
+	{
+		GenerateSection(ChunkX, ChunkY, section, sectionSide, sectionBlocks.GetData());
+		blocks.SetSection(section, sectionBlocks.GetData());
+	}
+}
+
+FNoiseTerrainGenerator::FNoiseTerrainGenerator(const FTerrainGenerationParams& params) :
+	mParams(params),
+	mHeightNoise(params.Seed),
+	mCaveNoise(params.Seed + 1),
+	mTemperatureNoise(params.Seed + 2),
+	mHumidityNoise(params.Seed + 3),
+	mFieldCache(FIELD_CACHE_TILES, [this](int32 worldX, int32 worldY, int32 side, FTerrainColumn* out) {
+		ComputeTile(worldX, worldY, side, out);
+	})
+{
+}
+
+void FNoiseTerrainGenerator::GenerateSection(int32 ChunkX, int32 ChunkY, int32 section, int32 sectionSide, BlockType* out) const
+{
+	TArray<FTerrainColumn> columns;
+	columns.SetNumUninitialized(sectionSide * sectionSide);
+	GetColumns(ChunkX, ChunkY, sectionSide, columns.GetData());
+
+	FillSection(ChunkX, ChunkY, section, sectionSide, columns.GetData(), out);
+}
+
+void FNoiseTerrainGenerator::GenerateChunk(int32 ChunkX, int32 ChunkY, FChunkBlockStorage& blocks) const
+{
+	int32 sectionSide = blocks.GetSectionSide();
+	int32 height = blocks.GetSectionCount() * sectionSide;
+
+	TArray<FTerrainColumn> columns;
+	columns.SetNumUninitialized(sectionSide * sectionSide);
+	GetColumns(ChunkX, ChunkY, sectionSide, columns.GetData());
+
+	int32 maxHeight = 0;
+	for (FTerrainColumn& column : columns)
+	{
+		column.Height = FMath::Min(column.Height, height - 1);
+		maxHeight = FMath::Max(maxHeight, column.Height);
+	}
+
+	TArray<BlockType> sectionBlocks;
+	sectionBlocks.SetNumUninitialized(sectionSide * sectionSide * sectionSide);
+
+	// Everything above the highest column stays AIR
+	for (int32 section = 0; section < blocks.GetSectionCount() && section * sectionSide <= maxHeight; section++)
+	{
+		FillSection(ChunkX, ChunkY, section, sectionSide, columns.GetData(), sectionBlocks.GetData());
+		blocks.SetSection(section, sectionBlocks.GetData());
+	}
+}
+
+void FNoiseTerrainGenerator::GetColumns(int32 ChunkX, int32 ChunkY, int32 sectionSide, FTerrainColumn* columns) const
+{
+	// k goes along X and j along Y, same as the block positions in AChunk
+	mFieldCache.GetColumns(ChunkX * sectionSide, ChunkY * sectionSide, sectionSide, sectionSide, columns);
+}
+
+void FNoiseTerrainGenerator::ComputeTile(int32 worldX, int32 worldY, int32 side, FTerrainColumn* out) const
+{
+	float frequency = mParams.HeightFrequency, climateFrequency = mParams.ClimateFrequency;
+
+	TArray<float> heights, temperatures, humidities;
+	heights.SetNumUninitialized(side);
+	temperatures.SetNumUninitialized(side);
+	humidities.SetNumUninitialized(side);
+
+	for (int32 y = 0; y < side; y++)
+	{
+		mHeightNoise.Fractal2DRow(worldX * frequency, (worldY + y) * frequency, frequency, side, mParams.HeightOctaves, heights.GetData());
+		mTemperatureNoise.Fractal2DRow(worldX * climateFrequency, (worldY + y) * climateFrequency, climateFrequency, side, 2, temperatures.GetData());
+		mHumidityNoise.Fractal2DRow(worldX * climateFrequency, (worldY + y) * climateFrequency, climateFrequency, side, 2, humidities.GetData());
+
+		for (int32 x = 0; x < side; x++)
+		{
+			FTerrainColumn& column = out[y * side + x];
+			column.Height = FMath::Max(1, mParams.BaseHeight + FMath::RoundToInt(heights[x] * mParams.HeightAmplitude));
+			column.Temperature = temperatures[x];
+			column.Humidity = humidities[x];
+		}
+	}
+}
+
+void FNoiseTerrainGenerator::FillSection(int32 ChunkX, int32 ChunkY, int32 section, int32 sectionSide,
+	const FTerrainColumn* columns, BlockType* out) const
+{
+	int32 baseI = section * sectionSide;
+
+	int32 maxHeight = 0;
+	for (int32 column = 0; column < sectionSide * sectionSide; column++)
+		maxHeight = FMath::Max(maxHeight, columns[column].Height);
+
+	// Cave noise on a coarse grid covering the section, only if a cave can reach it
+	bool hasCaves = mParams.CaveThreshold < 1.0f && baseI <= maxHeight - mParams.CaveSurfaceDepth;
+	int32 samples = FMath::DivideAndRoundUp(sectionSide, CAVE_CELL) + 1;
+	TArray<float> caveSamples;
+
+	if (hasCaves)
+	{
+		caveSamples.SetNumUninitialized(samples * samples * samples);
+		float frequency = mParams.CaveFrequency;
+
+		for (int32 si = 0; si < samples; si++)
+			for (int32 sj = 0; sj < samples; sj++)
+				for (int32 sk = 0; sk < samples; sk++)
+				{
+					caveSamples[(si * samples + sj) * samples + sk] = mCaveNoise.Noise3D(
+						(ChunkX * sectionSide + sk * CAVE_CELL) * frequency,
+						(ChunkY * sectionSide + sj * CAVE_CELL) * frequency,
+						(baseI + si * CAVE_CELL) * frequency);
+				}
+	}
+
+	auto caveAt = [&](int32 localI, int32 j, int32 k) -> float
+	{
+		int32 ci = localI / CAVE_CELL, cj = j / CAVE_CELL, ck = k / CAVE_CELL;
+		float fi = float(localI % CAVE_CELL) / CAVE_CELL, fj = float(j % CAVE_CELL) / CAVE_CELL, fk = float(k % CAVE_CELL) / CAVE_CELL;
+
+		auto sample = [&](int32 di, int32 dj, int32 dk) { return caveSamples[((ci + di) * samples + cj + dj) * samples + ck + dk]; };
+
+		float bottom = FMath::Lerp(FMath::Lerp(sample(0, 0, 0), sample(0, 0, 1), fk), FMath::Lerp(sample(0, 1, 0), sample(0, 1, 1), fk), fj);
+		float top = FMath::Lerp(FMath::Lerp(sample(1, 0, 0), sample(1, 0, 1), fk), FMath::Lerp(sample(1, 1, 0), sample(1, 1, 1), fk), fj);
+		return FMath::Lerp(bottom, top, fi);
+	};
+
+	int32 b = 0;
+	for (int32 localI = 0; localI < sectionSide; localI++)
+	{
+		int32 i = baseI + localI;
+
+		for (int32 j = 0; j < sectionSide; j++)
+		{
+			for (int32 k = 0; k < sectionSide; k++, b++)
+			{
+				int32 columnHeight = columns[j * sectionSide + k].Height;
+
+				BlockType blockType;
+				if (i > columnHeight) blockType = BlockType::AIR;
+				else if (i == columnHeight) blockType = BlockType::GRASS;
+				else if (i >= columnHeight - mParams.DirtDepth) blockType = BlockType::DIRT;
+				else blockType = BlockType::STONE;
+
+				// The bottom layer is never carved so there's always a floor
+				if (hasCaves && blockType != BlockType::AIR && i > 0 && i <= columnHeight - mParams.CaveSurfaceDepth &&
+					caveAt(localI, j, k) > mParams.CaveThreshold)
+				{
+					blockType = BlockType::AIR;
+				}
+
+				out[b] = blockType;
+			}
+		}
+	}
+}
+
+void FCallbackChunkGenerator::GenerateSection(int32 ChunkX, int32 ChunkY, int32 section, int32 sectionSide, BlockType* out) const
+{
+	int32 b = 0;
+	for (int32 localI = 0; localI < sectionSide; localI++)
+		for (int32 j = 0; j < sectionSide; j++)
+			for (int32 k = 0; k < sectionSide; k++, b++)
+				out[b] = mPopulateBlock(section * sectionSide + localI, j, k);
+}
@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Chunk.h"
+#include "GradientNoise.h"
+#include "TerrainFieldCache.h"
+#include "TerrainGenerator.generated.h"
+
+// Knobs of FNoiseTerrainGenerator, the only part of the terrain generation Blueprints get to touch
+USTRUCT(BlueprintType)
+struct FTerrainGenerationParams
+{
+	GENERATED_BODY()
+
+	// Same seed and params, same world
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain")
+	int32 Seed = 1337;
+
+	// Average height of the surface, in blocks
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain", meta = (ClampMin = "1"))
+	int32 BaseHeight = 64;
+
+	// How far the surface goes above and below BaseHeight, in blocks
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain", meta = (ClampMin = "0"))
+	float HeightAmplitude = 24.0f;
+
+	// Hills per block of the first octave, smaller is smoother
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain", meta = (ClampMin = "0"))
+	float HeightFrequency = 0.01f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain", meta = (ClampMin = "1", ClampMax = "8"))
+	int32 HeightOctaves = 4;
+
+	// Blocks of DIRT under the GRASS, then STONE
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain", meta = (ClampMin = "0"))
+	int32 DirtDepth = 3;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain", meta = (ClampMin = "0"))
+	float CaveFrequency = 0.05f;
+
+	// Blocks where the cave noise goes over this are carved out, 1 or more disables caves
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain")
+	float CaveThreshold = 0.45f;
+
+	// Caves stay this many blocks below the surface
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain", meta = (ClampMin = "0"))
+	int32 CaveSurfaceDepth = 5;
+
+	// Frequency of the temperature and humidity fields, much lower than the height so biomes span many chunks
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain", meta = (ClampMin = "0"))
+	float ClimateFrequency = 0.002f;
+};
+
+// Fills the blocks of a chunk. Implementations used by FChunkLoadScheduler run on the thread pool,
+// they have to be deterministic and not touch any UObject unless IsThreadSafe returns false.
+class MINECRAFTCLONE_API IChunkGenerator
+{
+public:
+	virtual ~IChunkGenerator() {}
+
+	// Fills one section, out holds sectionSide^3 blocks in GetPositionInTArray order with i relative to the section
+	virtual void GenerateSection(int32 ChunkX, int32 ChunkY, int32 section, int32 sectionSide, BlockType* out) const = 0;
+
+	// Fills every section of blocks, which is already initialized to the chunk size and all AIR
+	virtual void GenerateChunk(int32 ChunkX, int32 ChunkY, FChunkBlockStorage& blocks) const;
+
+	// Adds what goes on top of the terrain once GenerateChunk is done. Chunks loaded from a
+	// FChunkRegionStore were saved decorated and don't get it again
+	virtual void Decorate(int32 ChunkX, int32 ChunkY, FChunkBlockStorage& blocks) const {}
+
+	// False if it can only run on the game thread
+	virtual bool IsThreadSafe() const { return true; }
+};
+
+// Heightmap from fractal 2D noise with GRASS, DIRT and STONE layers, and caves carved with 3D noise.
+// The 2D fields are computed a tile of FTerrainFieldCache at a time and shared by every chunk of the
+// tile, sections above the surface are never touched and the cave noise is sampled every CAVE_CELL
+// blocks and interpolated in between.
+class MINECRAFTCLONE_API FNoiseTerrainGenerator : public IChunkGenerator
+{
+public:
+	explicit FNoiseTerrainGenerator(const FTerrainGenerationParams& params);
+
+	virtual void GenerateSection(int32 ChunkX, int32 ChunkY, int32 section, int32 sectionSide, BlockType* out) const override;
+
+	virtual void GenerateChunk(int32 ChunkX, int32 ChunkY, FChunkBlockStorage& blocks) const override;
+
+	// The 2D fields of every column of the chunk, columns holds sectionSide^2 values indexed by j * sectionSide + k
+	void GetColumns(int32 ChunkX, int32 ChunkY, int32 sectionSide, FTerrainColumn* columns) const;
+
+	const FTerrainFieldCache& GetFieldCache() const { return mFieldCache; }
+
+private:
+	static const int32 CAVE_CELL = 4;
+
+	// 4x4 chunks per tile, enough for a render distance of 12 chunks and some margin
+	static const int32 FIELD_CACHE_TILES = 64;
+
+	FTerrainGenerationParams mParams;
+	FGradientNoise mHeightNoise;
+	FGradientNoise mCaveNoise;
+	FGradientNoise mTemperatureNoise;
+	FGradientNoise mHumidityNoise;
+	FTerrainFieldCache mFieldCache;
+
+	void ComputeTile(int32 worldX, int32 worldY, int32 side, FTerrainColumn* out) const;
+
+	void FillSection(int32 ChunkX, int32 ChunkY, int32 section, int32 sectionSide, const FTerrainColumn* columns, BlockType* out) const;
+};
+
+// Calls PopulateBlock for every block with the i, j, k of the block inside the chunk, how chunks
+// were generated before the native generator. Blueprint callbacks are not thread safe.
+class MINECRAFTCLONE_API FCallbackChunkGenerator : public IChunkGenerator
+{
+public:
+	FCallbackChunkGenerator(TFunction<BlockType(int32 i, int32 j, int32 k)> populateBlock, bool bThreadSafe) :
+		mPopulateBlock(MoveTemp(populateBlock)), mThreadSafe(bThreadSafe) {}
+
+	virtual void GenerateSection(int32 ChunkX, int32 ChunkY, int32 section, int32 sectionSide, BlockType* out) const override;
+
+	virtual bool IsThreadSafe() const override { return mThreadSafe; }
+
+private:
+	TFunction<BlockType(int32 i, int32 j, int32 k)> mPopulateBlock;
+	bool mThreadSafe;
+};
@@ -0,0 +1,197 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VoxelRaycast.h"
+#include "Async/ParallelFor.h"
+
+// Blocks along X and Y of a chunk, see AChunk::GetChunkOrigin
+static const int32 CHUNK_SIDE = 16;
+
+// MeshData::Direction of the face looking towards -axis and +axis, for X, Y and Z
+static const int32 AXIS_FACES[3][2] = { { MeshData::LEFT, MeshData::RIGHT }, { MeshData::FORWARD, MeshData::BACK }, { MeshData::DOWN, MeshData::UP } };
+
+// Keeps the chunk of the last block, rays and sweeps mostly stay in the same chunk
+struct FChunkCursor
+{
+	AChunk* Chunk = nullptr;
+	int32 ChunkX = 0;
+	int32 ChunkY = 0;
+	bool bFound = false;
+
+	BlockType Get(int32 x, int32 y, int32 z)
+	{
+		int32 chunkX = FMath::DivideAndRoundDown(x, CHUNK_SIDE), chunkY = FMath::DivideAndRoundDown(y, CHUNK_SIDE);
+		if (!bFound || chunkX != ChunkX || chunkY != ChunkY)
+		{
+			Chunk = AChunk::FindChunk(chunkX, chunkY);
+			ChunkX = chunkX; ChunkY = chunkY;
+			bFound = true;
+		}
+
+		return Chunk ? Chunk->GetVoxel(z, y - chunkY * CHUNK_SIDE, x - chunkX * CHUNK_SIDE) : BlockType::AIR;
+	}
+};
+
+// Block coordinates of a world location, Z from the bottom of the chunks
+static FVector ToBlockSpace(const FVector& worldLocation)
+{
+	return (worldLocation - FVector(0, 0, AChunk::GetChunkOrigin(0, 0).Z)) / AChunk::BlockSize;
+}
+
+static void FillHit(FVoxelHit& hit, const FIntVector& block, BlockType type, int32 axis, int32 step)
+{
+	hit.bHit = true;
+	hit.Block = block;
+	hit.Type = type;
+	hit.Chunk = FVoxelRaycast::FindBlock(block, hit.I, hit.J, hit.K);
+	hit.ChunkX = FMath::DivideAndRoundDown(block.X, CHUNK_SIDE);
+	hit.ChunkY = FMath::DivideAndRoundDown(block.Y, CHUNK_SIDE);
+
+	hit.bStartSolid = axis < 0;
+	if (hit.bStartSolid) return;
+
+	// Moving along +axis the block is entered through its -axis face
+	hit.Face = AXIS_FACES[axis][step < 0];
+	hit.Normal[axis] = -step;
+}
+
+bool FVoxelRaycast::Raycast(const FVector& start, const FVector& direction, float maxDistance, FVoxelHit& hit)
+{
+	hit = FVoxelHit();
+
+	FVector dir = direction.GetSafeNormal();
+	if (dir.IsZero()) return false;
+
+	FVector p = ToBlockSpace(start);
+	FIntVector block(FMath::FloorToInt(p.X), FMath::FloorToInt(p.Y), FMath::FloorToInt(p.Z));
+
+	// tMax is the distance along the ray to the next block on each axis, tDelta the distance
+	// between two blocks, both in blocks
+	int32 step[3];
+	double tMax[3], tDelta[3];
+	for (int32 a = 0; a < 3; a++)
+	{
+		step[a] = dir[a] > 0 ? 1 : (dir[a] < 0 ? -1 : 0);
+		tDelta[a] = step[a] != 0 ? 1.0 / FMath::Abs(dir[a]) : TNumericLimits<double>::Max();
+		tMax[a] = step[a] > 0 ? (block[a] + 1 - p[a]) * tDelta[a] :
+			(step[a] < 0 ? (p[a] - block[a]) * tDelta[a] : TNumericLimits<double>::Max());
+	}
+
+	FChunkCursor cursor;
+	double t = 0, maxT = maxDistance / AChunk::BlockSize;
+	int32 axis = -1;
+
+	while (t <= maxT)
+	{
+		// Nothing below the chunks
+		if (block.Z < 0 && step[2] <= 0) break;
+
+		BlockType type = cursor.Get(block.X, block.Y, block.Z);
+		if (type != BlockType::AIR)
+		{
+			FillHit(hit, block, type, axis, axis >= 0 ? step[axis] : 0);
+			hit.Distance = t * AChunk::BlockSize;
+			hit.Location = start + dir * hit.Distance;
+			return true;
+		}
+
+		axis = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+		t = tMax[axis];
+		tMax[axis] += tDelta[axis];
+		block[axis] += step[axis];
+	}
+
+	return false;
+}
+
+void FVoxelRaycast::RaycastBatch(TArrayView<const FVoxelRay> rays, TArray<FVoxelHit>& hits)
+{
+	hits.SetNum(rays.Num());
+
+	ParallelFor(TEXT("VoxelRaycastBatch"), rays.Num(), 16, [&rays, &hits](int32 r)
+	{
+		Raycast(rays[r].Start, rays[r].Direction, rays[r].MaxDistance, hits[r]);
+	});
+}
+
+bool FVoxelRaycast::SweepBox(const FBox& box, const FVector& delta, FVoxelHit& hit)
+{
+	hit = FVoxelHit();
+
+	FVector lo = ToBlockSpace(box.Min), hi = ToBlockSpace(box.Max), d = delta / AChunk::BlockSize;
+	FVector sweptLo = lo.ComponentMin(lo + d), sweptHi = hi.ComponentMax(hi + d);
+
+	FChunkCursor cursor;
+	double bestT = TNumericLimits<double>::Max();
+	int32 bestAxis = -1;
+	FIntVector bestBlock;
+	BlockType bestType = BlockType::AIR;
+
+	for (int32 z = FMath::Max(FMath::FloorToInt(sweptLo.Z), 0); z <= FMath::FloorToInt(sweptHi.Z); z++)
+	{
+		for (int32 y = FMath::FloorToInt(sweptLo.Y); y <= FMath::FloorToInt(sweptHi.Y); y++)
+		{
+			for (int32 x = FMath::FloorToInt(sweptLo.X); x <= FMath::FloorToInt(sweptHi.X); x++)
+			{
+				BlockType type = cursor.Get(x, y, z);
+				if (!FBlockRegistry::IsSolid(type)) continue;
+
+				// When the box starts and stops overlapping the block on each axis, the box hits the
+				// block when it overlaps it on all of them
+				FIntVector block(x, y, z);
+				double tEnter = -TNumericLimits<double>::Max(), tExit = TNumericLimits<double>::Max();
+				int32 enterAxis = -1;
+				bool bMisses = false;
+
+				for (int32 a = 0; a < 3 && !bMisses; a++)
+				{
+					if (d[a] == 0)
+					{
+						// Only touching the block isn't overlapping it
+						bMisses = hi[a] <= block[a] || lo[a] >= block[a] + 1;
+						continue;
+					}
+
+					double t0 = (d[a] > 0 ? block[a] - hi[a] : block[a] + 1 - lo[a]) / d[a];
+					double t1 = (d[a] > 0 ? block[a] + 1 - lo[a] : block[a] - hi[a]) / d[a];
+					if (t0 > tEnter) { tEnter = t0; enterAxis = a; }
+					tExit = FMath::Min(tExit, t1);
+				}
+
+				if (bMisses || tEnter >= tExit || tExit <= 0 || tEnter > 1) continue;
+
+				// Already overlapping at the start
+				if (tEnter < 0) { tEnter = 0; enterAxis = -1; }
+
+				if (tEnter < bestT)
+				{
+					bestT = tEnter; bestAxis = enterAxis;
+					bestBlock = block; bestType = type;
+				}
+			}
+		}
+	}
+
+	if (bestType == BlockType::AIR) return false;
+
+	FillHit(hit, bestBlock, bestType, bestAxis, bestAxis >= 0 ? (d[bestAxis] > 0 ? 1 : -1) : 0);
+	hit.Distance = bestT * delta.Size();
+	hit.Location = box.GetCenter() + delta * bestT;
+	return true;
+}
+
+FIntVector FVoxelRaycast::GetBlockAt(const FVector& worldLocation)
+{
+	FVector p = ToBlockSpace(worldLocation);
+	return FIntVector(FMath::FloorToInt(p.X), FMath::FloorToInt(p.Y), FMath::FloorToInt(p.Z));
+}
+
+AChunk* FVoxelRaycast::FindBlock(const FIntVector& block, int32& i, int32& j, int32& k)
+{
+	int32 chunkX = FMath::DivideAndRoundDown(block.X, CHUNK_SIDE), chunkY = FMath::DivideAndRoundDown(block.Y, CHUNK_SIDE);
+
+	i = block.Z;
+	j = block.Y - chunkY * CHUNK_SIDE;
+	k = block.X - chunkX * CHUNK_SIDE;
+
+	return AChunk::FindChunk(chunkX, chunkY);
+}
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Chunk.h"
+
+// A block found by FVoxelRaycast
+struct FVoxelHit
+{
+	bool bHit = false;
+
+	// The query started inside a solid block, Face is -1 and Distance 0 then
+	bool bStartSolid = false;
+
+	AChunk* Chunk = nullptr;
+	int32 ChunkX = 0;
+	int32 ChunkY = 0;
+
+	// Block in world block coordinates, Z counts from the bottom of the chunks
+	FIntVector Block = FIntVector::ZeroValue;
+
+	// Same block inside Chunk, i is the height
+	int32 I = 0;
+	int32 J = 0;
+	int32 K = 0;
+
+	BlockType Type = BlockType::AIR;
+
+	// Face of the block that was hit, a MeshData::Direction, and the step from the block out of it
+	int32 Face = -1;
+	FIntVector Normal = FIntVector::ZeroValue;
+
+	// Where the ray hit the face, for sweeps where the center of the box stops
+	FVector Location = FVector::ZeroVector;
+	float Distance = 0;
+};
+
+struct FVoxelRay
+{
+	FVector Start = FVector::ZeroVector;
+	FVector Direction = FVector::ForwardVector;
+	float MaxDistance = 0;
+};
+
+// Queries against the blocks of the chunks in the AChunk::ChunkRegistry, so they don't depend on the
+// cooked collision of the meshes. Unloaded chunks are empty. Game thread only, the chunks can't
+// change while a query runs; RaycastBatch spreads the rays over worker threads and waits for them.
+class MINECRAFTCLONE_API FVoxelRaycast
+{
+public:
+	// Steps through the blocks along the ray one at a time (Amanatides & Woo), maxDistance in world units.
+	// Stops at any block that isn't AIR, so blocks that don't collide can still be targeted
+	static bool Raycast(const FVector& start, const FVector& direction, float maxDistance, FVoxelHit& hit);
+
+	// hits[r] is the result of rays[r]
+	static void RaycastBatch(TArrayView<const FVoxelRay> rays, TArray<FVoxelHit>& hits);
+
+	// First solid block (see FBlockRegistry) the box runs into when moved by delta. Checks every block around the whole move,
+	// so it's meant for short moves like characters or projectiles on a frame
+	static bool SweepBox(const FBox& box, const FVector& delta, FVoxelHit& hit);
+
+	// Block containing the world location
+	static FIntVector GetBlockAt(const FVector& worldLocation);
+
+	// Loaded chunk containing the block, and the block inside it
+	static AChunk* FindBlock(const FIntVector& block, int32& i, int32& j, int32& k);
+};